@@ -0,0 +1,342 @@
+#include "corpus.hpp"
+
+#include <pex_loader/pex_loader.hpp>
+#include <pex_loader/relocations.hpp>
+#include <pex_loader/string_table.hpp>
+#include <pex_loader/symbol_table.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <tuple>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace pex::loader::bench
+{
+
+namespace
+{
+
+/// Names of the sections filled with generated payloads
+///
+/// Typed sections which the loader parses (relocations, imports, symbols, ...) must not get random
+/// contents, so they are never picked here; relocations are generated separately.
+constexpr std::array<std::array<char, 4>, 4> section_names = {{
+    {'C', 'O', 'D', 'E'},
+    {'D', 'A', 'T', 'A'},
+    {'C', 'O', 'N', 'S'},
+    {'L', 'I', 'N', 'E'},
+}};
+
+/// Average distance between two relocations of a code or data section
+constexpr uint64_t relocation_spacing = 64;
+
+
+uint64_t parse_number(std::string_view value)
+{
+    std::string str(value);
+    char* end = nullptr;
+    errno = 0;
+    auto number = std::strtoull(str.c_str(), &end, 10);
+    if (str.empty() || errno != 0 || *end != '\0') {
+        throw LoaderError("Invalid number: '" + str + "'");
+    }
+    return number;
+}
+
+
+std::pair<uint64_t, uint64_t> parse_range(std::string_view value)
+{
+    auto colon = value.find(':');
+    if (colon == std::string_view::npos) {
+        auto number = parse_number(value);
+        return {number, number};
+    }
+    auto range = std::make_pair(parse_number(value.substr(0, colon)), parse_number(value.substr(colon + 1)));
+    if (range.first > range.second) {
+        throw LoaderError("Invalid range: '" + std::string(value) + "'");
+    }
+    return range;
+}
+
+
+std::string generate_payload(Payload payload, uint64_t size, std::mt19937_64& rng)
+{
+    std::string data;
+    data.reserve(size);
+    switch (payload) {
+        case Payload::random: {
+            while (data.size() < size) {
+                auto word = rng();
+                data.append(reinterpret_cast<const char*>(&word), std::min<uint64_t>(8, size - data.size()));
+            }
+            break;
+        }
+        case Payload::compressible: {
+            static const std::array<std::string_view, 16> vocabulary = {
+                "load_const ", "call ", "return ", "jump_if ", "store_local ", "load_local ", "add ", "self",
+                "__init__", "value", "index ", "0 ", "1 ", "None ", "\x01\x00\x00\x00", "\n",
+            };
+            while (data.size() < size) {
+                auto word = vocabulary[rng() % vocabulary.size()];
+                data.append(word.substr(0, std::min<uint64_t>(word.size(), size - data.size())));
+            }
+            break;
+        }
+        case Payload::zeros: {
+            data.assign(size, '\0');
+            break;
+        }
+    }
+    return data;
+}
+
+
+std::string generate_image(const CorpusOptions& options, std::mt19937_64& rng)
+{
+    std::uniform_int_distribution<size_t> section_count(options.min_sections, options.max_sections);
+    std::uniform_real_distribution<double> log_size(
+        std::log(double(std::max<uint64_t>(options.min_section_size, 1))),
+        std::log(double(std::max<uint64_t>(options.max_section_size, 1)))
+    );
+
+    std::vector<std::string> payloads(section_count(rng));
+    std::vector<v0::SectionContents> sections;
+    sections.reserve(payloads.size());
+    for (auto& payload : payloads) {
+        auto size = std::clamp<uint64_t>(
+            uint64_t(std::exp(log_size(rng))),
+            options.min_section_size,
+            options.max_section_size
+        );
+        payload = generate_payload(options.payload, size, rng);
+        sections.push_back(v0::SectionContents{section_names[rng() % section_names.size()], payload});
+    }
+
+    // Typed sections follow the byte order of the file
+    auto order = options.format_major == 0 ? ByteOrder::big : v1::byte_order(options.feature_flags);
+
+    // A valid relocation table patching 32-bit fields of the code and data sections
+    std::vector<v0::Relocation> relocations;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        const auto& section = sections[i];
+        if ((section.name != section_names[0] && section.name != section_names[1]) || section.data.size() < 4) {
+            continue;
+        }
+        auto count = std::max<uint64_t>(section.data.size() / relocation_spacing, 1);
+        for (uint64_t j = 0; j < count; ++j) {
+            auto offset = rng() % (section.data.size() - 3);
+            relocations.push_back({uint32_t(i), v0::RelocationType::add32, offset});
+        }
+    }
+    std::string relocation_table;
+    if (!relocations.empty()) {
+        relocation_table = v0::build_relocation_table(std::move(relocations), order);
+        sections.push_back(v0::SectionContents{v0::relocation_section_name, relocation_table});
+    }
+
+    std::string symbol_table;
+    std::string string_table;
+    if (options.symbols_per_file != 0) {
+        std::set<size_t> chosen;
+        while (chosen.size() < std::min(options.symbols_per_file, symbol_pool_size)) {
+            chosen.insert(rng() % symbol_pool_size);
+        }
+        std::vector<std::string> names;
+        std::vector<std::pair<std::string, uint64_t>> symbols;
+        for (auto index : chosen) {
+            names.push_back(symbol_name(index));
+            symbols.emplace_back(names.back(), rng());
+        }
+        symbol_table = v0::build_symbol_table(symbols, order);
+        string_table = v0::build_string_table(std::vector<std::string_view>(names.begin(), names.end()), order);
+        sections.push_back(v0::SectionContents{v0::section_name("SYMT"), symbol_table});
+        sections.push_back(v0::SectionContents{v0::section_name("STRT"), string_table});
+    }
+
+    auto header = write_early_header({EarlyHeaderInfo::FileType::library, {options.format_major, 0}});
+    if (options.format_major == 0) {
+        return header + v0::write_sections(sections);
+    }
+    return header + v1::write_sections(options.feature_flags, sections);
+}
+
+
+void write_file(const std::string& path, const std::string& contents)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw LoaderError("Unable to create '" + path + "': " + std::strerror(errno));
+    }
+    size_t written = 0;
+    while (written < contents.size()) {
+        auto result = write(fd, contents.data() + written, contents.size() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            close(fd);
+            throw LoaderError("Unable to write '" + path + "': " + std::strerror(errno));
+        }
+        written += size_t(result);
+    }
+    // Dirty pages cannot be dropped from the page cache, so cold runs need them written back
+    fdatasync(fd);
+    close(fd);
+}
+
+}
+
+
+const char* const corpus_options_usage =
+    "  --files=N                 number of files (default 200)\n"
+    "  --sections=MIN:MAX        sections per file (default 4:64)\n"
+    "  --section-size=MIN:MAX    section size in bytes, log-uniform (default 64:262144)\n"
+    "  --payload=KIND            random, compressible or zeros (default compressible)\n"
+    "  --format=MAJOR            format major version, 0 or 1 (default 0)\n"
+    "  --feature-flags=N         feature flags of version 1 files (default 0)\n"
+    "  --symbols=N               symbols per file, 0 for none (default 256)\n"
+    "  --seed=N                  random seed (default 1)\n";
+
+
+bool parse_corpus_option(std::string_view arg, CorpusOptions& options)
+{
+    auto equals = arg.find('=');
+    if (arg.substr(0, 2) != "--" || equals == std::string_view::npos) {
+        return false;
+    }
+    auto name = arg.substr(2, equals - 2);
+    auto value = arg.substr(equals + 1);
+
+    if (name == "files") {
+        options.file_count = parse_number(value);
+    } else if (name == "sections") {
+        std::tie(options.min_sections, options.max_sections) = parse_range(value);
+    } else if (name == "section-size") {
+        std::tie(options.min_section_size, options.max_section_size) = parse_range(value);
+    } else if (name == "payload") {
+        if (value == "random") {
+            options.payload = Payload::random;
+        } else if (value == "compressible") {
+            options.payload = Payload::compressible;
+        } else if (value == "zeros") {
+            options.payload = Payload::zeros;
+        } else {
+            throw LoaderError("Unknown payload kind: '" + std::string(value) + "'");
+        }
+    } else if (name == "format") {
+        auto major = parse_number(value);
+        if (major > 1) {
+            throw LoaderError("Unsupported format major version: " + std::string(value));
+        }
+        options.format_major = uint16_t(major);
+    } else if (name == "feature-flags") {
+        options.feature_flags = uint32_t(parse_number(value));
+    } else if (name == "symbols") {
+        options.symbols_per_file = parse_number(value);
+    } else if (name == "seed") {
+        options.seed = parse_number(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+std::string symbol_name(size_t index)
+{
+    static const std::array<std::string_view, 8> prefixes = {
+        "get_", "set_", "__init__", "load_", "parse_", "visit_", "to_string", "is_",
+    };
+    return std::string(prefixes[index % prefixes.size()]) + std::to_string(index);
+}
+
+
+std::vector<std::string> write_corpus(const std::string& directory, const CorpusOptions& options)
+{
+    std::mt19937_64 rng(options.seed);
+    std::vector<std::string> paths;
+    paths.reserve(options.file_count);
+    for (size_t i = 0; i < options.file_count; ++i) {
+        char name[48];
+        std::snprintf(name, sizeof(name), "/module_%06zu.pex", i);
+        paths.push_back(directory + name);
+        write_file(paths.back(), generate_image(options, rng));
+    }
+    return paths;
+}
+
+
+std::vector<std::string> list_corpus(const std::string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        throw LoaderError("Unable to open directory '" + directory + "': " + std::strerror(errno));
+    }
+    std::vector<std::string> paths;
+    while (auto entry = readdir(dir)) {
+        std::string_view name = entry->d_name;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".pex") {
+            paths.push_back(directory + "/" + std::string(name));
+        }
+    }
+    closedir(dir);
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+
+void drop_cached_pages(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+
+std::string make_temp_directory()
+{
+    char path[] = "/tmp/pex_loader_bench_XXXXXX";
+    if (mkdtemp(path) == nullptr) {
+        throw LoaderError(std::string("Unable to create a temporary directory: ") + std::strerror(errno));
+    }
+    return path;
+}
+
+
+void remove_corpus(const std::string& directory, const std::vector<std::string>& paths)
+{
+    for (const auto& path : paths) {
+        unlink(path.c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+
+uint64_t total_size(const std::vector<std::string>& paths)
+{
+    uint64_t total = 0;
+    for (const auto& path : paths) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            total += uint64_t(st.st_size);
+        }
+    }
+    return total;
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// Helpers shared by the benchmarks: a generator of synthetic PEX files and file system utilities
+namespace pex::loader::bench
+{
+
+/// Contents of the generated sections
+///
+/// Payloads only go to sections the loader treats as opaque ("CODE", "DATA", "CONS" and "LINE");
+/// every file with code or data also gets a valid relocation table ("RELO") patching them.
+enum class Payload
+{
+    /// Uniformly random bytes, which do not compress at all
+    random,
+    /// Words drawn from a small vocabulary, which compress about like code and string tables
+    compressible,
+    zeros,
+};
+
+
+/// Shape of a generated corpus
+struct CorpusOptions
+{
+    size_t file_count = 200;
+
+    /// Section counts are uniformly distributed in `[min_sections, max_sections]`
+    size_t min_sections = 4;
+    size_t max_sections = 64;
+
+    /// Section sizes are log-uniformly distributed in `[min_section_size, max_section_size]`, so
+    /// most sections are small and a few are large
+    uint64_t min_section_size = 64;
+    uint64_t max_section_size = 256 << 10;
+
+    Payload payload = Payload::compressible;
+
+    /// Every file also gets a symbol table ("SYMT") and a string table ("STRT") section of this
+    /// many names drawn from a pool shared by the whole corpus (0 disables them)
+    size_t symbols_per_file = 256;
+
+    /// Format major version of the files (0 or 1) and feature flags of version 1 files
+    uint16_t format_major = 0;
+    uint32_t feature_flags = 0;
+
+    uint64_t seed = 1;
+};
+
+
+/// Parses a `--name=value` option of the corpus shape; returns false if `arg` is not one.
+/// Throws `LoaderError` if the value is invalid
+bool parse_corpus_option(std::string_view arg, CorpusOptions& options);
+
+/// Usage text describing the options accepted by `parse_corpus_option`
+extern const char* const corpus_options_usage;
+
+/// Returns the name of a symbol from the pool shared by the corpus
+std::string symbol_name(size_t index);
+
+/// Number of names in the pool shared by the corpus
+constexpr size_t symbol_pool_size = 4096;
+
+/// Generates the corpus into `directory` (which must exist) and returns the paths of the files.
+/// The files are flushed to disk, so that their pages can be dropped from the page cache
+std::vector<std::string> write_corpus(const std::string& directory, const CorpusOptions& options);
+
+/// Returns the paths of the `.pex` files in the directory, sorted
+std::vector<std::string> list_corpus(const std::string& directory);
+
+/// Asks the kernel to drop the cached pages of the file (see `POSIX_FADV_DONTNEED`)
+void drop_cached_pages(const std::string& path);
+
+/// Creates a new temporary directory
+std::string make_temp_directory();
+
+/// Removes the files and then the directory
+void remove_corpus(const std::string& directory, const std::vector<std::string>& paths);
+
+/// Returns the sum of the sizes of the files
+uint64_t total_size(const std::vector<std::string>& paths);
+
+}
@@ -0,0 +1,185 @@
+// Measures end-to-end loading of a PEX corpus: opening and mapping the files, parsing their
+// section tables and reading the section data.
+//
+// Every configuration is run with a cold page cache (the corpus pages are dropped before each
+// iteration) and with a warm one, by a single thread and by several threads sharing the corpus.
+// Without `--corpus` a synthetic corpus is generated into a temporary directory.
+
+#include "corpus.hpp"
+
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/section_store.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+
+using namespace pex::loader;
+
+
+struct BenchmarkOptions
+{
+    std::string corpus_directory;
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    size_t iterations = 5;
+    /// Only map the files and parse their section tables, without reading the section data
+    bool parse_only = false;
+};
+
+
+uint64_t load_file(const std::string& path, bool parse_only)
+{
+    MappedFile file(path);
+    uint64_t checksum = file.sections().size();
+    if (!parse_only) {
+        for (const auto& section : file.sections()) {
+            checksum ^= content_hash(file.section_data(section));
+        }
+    }
+    return checksum;
+}
+
+
+/// Loads every file once with `thread_count` threads; returns the elapsed seconds
+double load_corpus(const std::vector<std::string>& paths, size_t thread_count, bool parse_only, uint64_t& checksum)
+{
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> combined{0};
+    auto worker = [&]() {
+        uint64_t local = 0;
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            // Addition keeps the checksum independent of the order in which files are loaded
+            local += load_file(paths[i], parse_only);
+        }
+        combined += local;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    checksum = combined;
+    return std::chrono::duration<double>(elapsed).count();
+}
+
+
+void run(const std::vector<std::string>& paths, const BenchmarkOptions& options)
+{
+    auto bytes = bench::total_size(paths);
+    std::printf(
+        "%zu files, %.1f MiB%s\n",
+        paths.size(),
+        double(bytes) / (1 << 20),
+        options.parse_only ? ", parse only" : ""
+    );
+    std::printf("%-6s %8s %12s %12s %12s\n", "cache", "threads", "median ms", "files/s", "MiB/s");
+
+    std::vector<size_t> thread_counts = {1};
+    if (options.thread_count > 1) {
+        thread_counts.push_back(options.thread_count);
+    }
+
+    uint64_t expected_checksum = 0;
+    bool has_checksum = false;
+    for (bool cold : {true, false}) {
+        for (auto thread_count : thread_counts) {
+            if (!cold) {
+                // Warm-up run
+                uint64_t checksum;
+                load_corpus(paths, thread_count, options.parse_only, checksum);
+            }
+
+            std::vector<double> times;
+            for (size_t i = 0; i < options.iterations; ++i) {
+                if (cold) {
+                    for (const auto& path : paths) {
+                        bench::drop_cached_pages(path);
+                    }
+                }
+                uint64_t checksum;
+                times.push_back(load_corpus(paths, thread_count, options.parse_only, checksum));
+                if (has_checksum && checksum != expected_checksum) {
+                    throw LoaderError("Corpus contents changed during the benchmark");
+                }
+                expected_checksum = checksum;
+                has_checksum = true;
+            }
+
+            std::sort(times.begin(), times.end());
+            auto median = times[times.size() / 2];
+            std::printf(
+                "%-6s %8zu %12.2f %12.0f %12.1f\n",
+                cold ? "cold" : "warm",
+                thread_count,
+                median * 1000,
+                double(paths.size()) / median,
+                double(bytes) / (1 << 20) / median
+            );
+        }
+    }
+}
+
+}
+
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    bench::CorpusOptions corpus_options;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.rfind("--corpus=", 0) == 0) {
+                options.corpus_directory = arg.substr(9);
+            } else if (arg.rfind("--threads=", 0) == 0) {
+                options.thread_count = std::max<size_t>(1, std::stoul(arg.substr(10)));
+            } else if (arg.rfind("--iterations=", 0) == 0) {
+                options.iterations = std::max<size_t>(1, std::stoul(arg.substr(13)));
+            } else if (arg == "--parse-only") {
+                options.parse_only = true;
+            } else if (!bench::parse_corpus_option(arg, corpus_options)) {
+                std::cerr << "Usage: " << argv[0]
+                    << " [--corpus=DIR] [--threads=N] [--iterations=N] [--parse-only] [corpus options]\n"
+                    << bench::corpus_options_usage;
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!options.corpus_directory.empty()) {
+            run(bench::list_corpus(options.corpus_directory), options);
+            return EXIT_SUCCESS;
+        }
+
+        auto directory = bench::make_temp_directory();
+        try {
+            run(bench::write_corpus(directory, corpus_options), options);
+        } catch (...) {
+            bench::remove_corpus(directory, bench::list_corpus(directory));
+            throw;
+        }
+        bench::remove_corpus(directory, bench::list_corpus(directory));
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+// Generates a synthetic PEX corpus for the benchmarks.
+
+#include "corpus.hpp"
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+
+int main(int argc, char** argv)
+{
+    using namespace pex::loader;
+
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <directory> [options]\n" << bench::corpus_options_usage;
+        return EXIT_FAILURE;
+    }
+
+    try {
+        bench::CorpusOptions options;
+        for (int i = 2; i < argc; ++i) {
+            if (!bench::parse_corpus_option(argv[i], options)) {
+                throw LoaderError(std::string("Unknown option: '") + argv[i] + "'");
+            }
+        }
+        auto paths = bench::write_corpus(argv[1], options);
+        std::cout << "Generated " << paths.size() << " files, " << bench::total_size(paths) << " bytes\n";
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+// Measures how loading and lookups scale with the number of concurrent threads.
+//
+// For every thread count from 1 up to the number of cores (doubling, plus the core count), the
+// threads run a mix of operations over a shared corpus for a fixed time:
+//
+//  - load: map a file with section deduplication through the global `SectionStore` and read
+//    its sections;
+//  - lookup: parse the symbol table of a resident file and look up names in it;
+//  - intern: intern the strings of a resident file's string table into a shared `StringInterner`.
+//
+// Throughput and p50/p99 latencies are reported per thread count and operation, so that
+// contention on the shared state shows up as a scaling cliff.
+
+#include "corpus.hpp"
+
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/section_store.hpp>
+#include <pex_loader/string_table.hpp>
+#include <pex_loader/symbol_table.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+
+using namespace pex::loader;
+using Clock = std::chrono::steady_clock;
+
+
+struct BenchmarkOptions
+{
+    std::string corpus_directory;
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::chrono::milliseconds duration{1000};
+    /// Names looked up or interned by a single operation
+    size_t batch_size = 64;
+};
+
+
+enum Operation
+{
+    load_operation,
+    lookup_operation,
+    intern_operation,
+    operation_count,
+};
+
+constexpr std::array<const char*, operation_count> operation_names = {"load", "lookup", "intern"};
+
+
+struct SharedState
+{
+    const std::vector<std::string>& paths;
+    /// Files kept loaded for the whole run, so that lookups and interning do not measure loading
+    std::vector<std::unique_ptr<MappedFile>> resident;
+    LoadOptions load_options;
+    StringInterner interner;
+    size_t batch_size;
+};
+
+
+uint64_t run_operation(Operation operation, SharedState& state, std::mt19937_64& rng)
+{
+    uint64_t checksum = 0;
+    switch (operation) {
+        case load_operation: {
+            MappedFile file(state.paths[rng() % state.paths.size()], state.load_options);
+            for (const auto& section : file.sections()) {
+                checksum += file.section_data(section).size();
+            }
+            break;
+        }
+        case lookup_operation: {
+            const auto& file = *state.resident[rng() % state.resident.size()];
+            auto section = file.find_section(v0::section_name("SYMT"));
+            if (section == nullptr) {
+                break;
+            }
+            v0::SymbolTable table(file.section_data(*section), file.byte_order());
+            for (size_t i = 0; i < state.batch_size; ++i) {
+                auto symbol = table.lookup(bench::symbol_name(rng() % bench::symbol_pool_size));
+                checksum += symbol ? symbol->value : 0;
+            }
+            break;
+        }
+        case intern_operation: {
+            const auto& file = *state.resident[rng() % state.resident.size()];
+            auto section = file.find_section(v0::section_name("STRT"));
+            if (section == nullptr) {
+                break;
+            }
+            v0::StringTable table(file.section_data(*section), file.byte_order());
+            for (size_t i = 0; i < state.batch_size && table.size() != 0; ++i) {
+                checksum += table.intern(uint32_t(rng() % table.size()), state.interner).size();
+            }
+            break;
+        }
+        case operation_count: {
+            break;
+        }
+    }
+    return checksum;
+}
+
+
+double percentile(std::vector<double>& values, double fraction)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    auto index = std::min(values.size() - 1, size_t(fraction * double(values.size())));
+    std::nth_element(values.begin(), values.begin() + ptrdiff_t(index), values.end());
+    return values[index];
+}
+
+
+void run_thread_count(SharedState& state, size_t thread_count, const BenchmarkOptions& options)
+{
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> sink{0};
+    std::vector<std::array<std::vector<double>, operation_count>> latencies(thread_count);
+
+    auto worker = [&](size_t thread_index) {
+        std::mt19937_64 rng(thread_index + 1);
+        auto& own = latencies[thread_index];
+        uint64_t checksum = 0;
+        for (size_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+            auto operation = Operation(i % operation_count);
+            auto start = Clock::now();
+            checksum += run_operation(operation, state, rng);
+            own[operation].push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        sink += checksum;
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    std::this_thread::sleep_for(options.duration);
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto seconds = std::chrono::duration<double>(options.duration).count();
+    for (size_t operation = 0; operation < operation_count; ++operation) {
+        std::vector<double> merged;
+        for (auto& own : latencies) {
+            merged.insert(merged.end(), own[operation].begin(), own[operation].end());
+        }
+        auto count = merged.size();
+        auto p50 = percentile(merged, 0.5);
+        auto p99 = percentile(merged, 0.99);
+        std::printf(
+            "%8zu %-8s %14.0f %12.2f %12.2f\n",
+            thread_count,
+            operation_names[operation],
+            double(count) / seconds,
+            p50,
+            p99
+        );
+    }
+}
+
+
+void run(const std::vector<std::string>& paths, const BenchmarkOptions& options)
+{
+    if (paths.empty()) {
+        throw LoaderError("The corpus is empty");
+    }
+
+    std::vector<size_t> thread_counts;
+    for (size_t count = 1; count < options.max_threads; count *= 2) {
+        thread_counts.push_back(count);
+    }
+    thread_counts.push_back(options.max_threads);
+
+    std::printf(
+        "%zu files, up to %zu threads, %lld ms per thread count\n",
+        paths.size(),
+        options.max_threads,
+        static_cast<long long>(options.duration.count())
+    );
+    std::printf("%8s %-8s %14s %12s %12s\n", "threads", "op", "ops/s", "p50 us", "p99 us");
+
+    for (auto thread_count : thread_counts) {
+        // A fresh interner per thread count, so that every run starts by inserting
+        SharedState state{paths, {}, {}, {}, options.batch_size};
+        state.load_options.deduplication_threshold = 4096;
+        for (const auto& path : paths) {
+            state.resident.push_back(std::make_unique<MappedFile>(path));
+        }
+        run_thread_count(state, thread_count, options);
+    }
+}
+
+}
+
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    bench::CorpusOptions corpus_options;
+    corpus_options.file_count = 64;
+    corpus_options.max_section_size = 64 << 10;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.rfind("--corpus=", 0) == 0) {
+                options.corpus_directory = arg.substr(9);
+            } else if (arg.rfind("--max-threads=", 0) == 0) {
+                options.max_threads = std::max<size_t>(1, std::stoul(arg.substr(14)));
+            } else if (arg.rfind("--duration-ms=", 0) == 0) {
+                options.duration = std::chrono::milliseconds(std::stoul(arg.substr(14)));
+            } else if (arg.rfind("--batch=", 0) == 0) {
+                options.batch_size = std::stoul(arg.substr(8));
+            } else if (!bench::parse_corpus_option(arg, corpus_options)) {
+                std::cerr << "Usage: " << argv[0]
+                    << " [--corpus=DIR] [--max-threads=N] [--duration-ms=N] [--batch=N] [corpus options]\n"
+                    << bench::corpus_options_usage;
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!options.corpus_directory.empty()) {
+            run(bench::list_corpus(options.corpus_directory), options);
+            return EXIT_SUCCESS;
+        }
+
+        auto directory = bench::make_temp_directory();
+        try {
+            run(bench::write_corpus(directory, corpus_options), options);
+        } catch (...) {
+            bench::remove_corpus(directory, bench::list_corpus(directory));
+            throw;
+        }
+        bench::remove_corpus(directory, bench::list_corpus(directory));
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+/// Single file containing many PEX images, mapped once and indexed by module name
+///
+/// Layout (all integers are big-endian, offsets are from the start of the bundle):
+///
+///     u8  magic[4] = "PEXB"
+///     u32 bundle_version = 0
+///     u64 module_count
+///     { u64 name_offset; u64 name_size; u64 image_offset; u64 image_size } index[module_count]
+///     u8  names[]
+///     u8  images[]
+///
+/// The index is sorted by module name, so a module is found with a binary search over the mapped
+/// index. Images written by `write_bundle` start at page boundaries.
+class Bundle
+{
+public:
+    /// Maps the bundle and validates its index; throws `LoaderError` on failure
+    ///
+    /// Pass `huge_page_aligned` when modules are going to be loaded with
+    /// `LoadOptions::huge_page_threshold`, see `FileMapping`.
+    explicit Bundle(const std::string& path, bool huge_page_aligned = false);
+
+    size_t size() const
+    {
+        return module_count;
+    }
+
+    std::string_view module_name(size_t index) const;
+
+    /// Returns the PEX image of the module, or `std::nullopt` if the bundle does not contain it
+    std::optional<std::string_view> find(std::string_view name) const;
+
+    /// Parses the module's image; throws `LoaderError` if the bundle does not contain it
+    std::shared_ptr<MappedFile> load(std::string_view name, const LoadOptions& options = {}) const;
+
+private:
+    struct Entry
+    {
+        std::string_view name;
+        std::string_view image;
+    };
+
+    Entry entry(size_t index) const;
+
+    std::shared_ptr<const FileMapping> mapping;
+    uint64_t module_count;
+};
+
+
+/// Serializes a bundle from (module name, PEX image) pairs; names must be unique
+std::string write_bundle(std::vector<std::pair<std::string_view, std::string_view>> modules);
+
+
+} // namespace pex::loader
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+namespace v0
+{
+    /// Decoded constant: an integer, a floating-point number or a string
+    using Constant = std::variant<int64_t, double, std::string>;
+
+    /// Constant pool section decoded lazily, one constant at a time
+    ///
+    /// Section layout (all integers and floating-point numbers are in the byte order of the file):
+    ///
+    ///     u32 constant_count
+    ///     u32 offsets[constant_count + 1]   (offsets into `data`, the last one is its size)
+    ///     u8  data[]
+    ///
+    /// Every constant starts with a tag byte: 0 for a `i64`, 1 for an IEEE 754 `f64` (both
+    /// followed by 8 bytes), 2 for a string (followed by its bytes, up to the next offset).
+    ///
+    /// Only the header is validated on construction. A constant is validated and decoded on its
+    /// first access and then published with a compare-and-swap, so concurrent readers never block
+    /// each other; if two of them race to decode the same constant, one copy is discarded.
+    ///
+    /// The pool does not own the section data, which must outlive it.
+    class ConstantPool
+    {
+    public:
+        /// Parses the section header; throws `LoaderError` if it is malformed
+        explicit ConstantPool(std::string_view section_data, ByteOrder order = ByteOrder::big);
+        ~ConstantPool();
+
+        ConstantPool(const ConstantPool&) = delete;
+        ConstantPool& operator=(const ConstantPool&) = delete;
+
+        uint32_t size() const
+        {
+            return constant_count;
+        }
+
+        /// Returns the constant, decoding it on the first access; throws `LoaderError` if the index
+        /// is out of range or the constant is malformed
+        const Constant& operator[](uint32_t index) const;
+
+        /// Number of constants decoded so far
+        uint32_t decoded_count() const;
+
+    private:
+        Constant decode(uint32_t index) const;
+
+        ByteOrder order;
+        uint32_t constant_count;
+        const char* offsets;
+        std::string_view data;
+        std::unique_ptr<std::atomic<const Constant*>[]> constants;
+    };
+
+    /// Serializes a constant pool section
+    std::string build_constant_pool(const std::vector<Constant>& constants, ByteOrder order = ByteOrder::big);
+}
+
+
+} // namespace pex::loader
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/pex_loader.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+namespace v0
+{
+    /// Name of the section referencing the companion file holding the debug sections
+    constexpr auto debug_link_section_name = section_name("DBGL");
+
+    /// Contents of a debug link section
+    ///
+    /// Section layout (all integers are in the byte order of the file):
+    ///
+    ///     u64 checksum     (`content_hash` of the companion file after its early header)
+    ///     u32 path_size
+    ///     u8  path[path_size]   (relative to the directory of the main file, unless absolute)
+    struct DebugLink
+    {
+        std::string_view path;
+        uint64_t checksum;
+    };
+
+    DebugLink read_debug_link(std::string_view section_data, ByteOrder order = ByteOrder::big);
+    std::string write_debug_link(const DebugLink& link, ByteOrder order = ByteOrder::big);
+
+    /// Sections of a file split into the main part and the debug part
+    struct SplitSections
+    {
+        std::string main_sections;
+        std::string debug_sections;
+    };
+
+    /// Moves the sections with the given names out of the section data of a file
+    ///
+    /// The main part keeps all the other sections in their order, followed by a debug link to
+    /// `debug_path`. Both parts are returned without the early header. Relocation sections are
+    /// rewritten for the remaining sections; relocations targeting a debug section are rejected.
+    SplitSections split_debug_sections(
+        const std::string_view& data,
+        const std::vector<std::array<char, 4>>& debug_section_names,
+        const std::string& debug_path
+    );
+}
+
+
+/// Debug sections of a loaded file, either stored in the file itself or in a companion file
+///
+/// The companion file referenced by the debug link is only opened, mapped and verified on the
+/// first request for a section which is not in the main file, so loads which never need debug
+/// information do not pay for it.
+class DebugInfo
+{
+public:
+    /// The file must outlive the debug info
+    explicit DebugInfo(const MappedFile& file);
+
+    /// Returns true if the file has a debug link
+    bool has_debug_link() const
+    {
+        return debug_link != nullptr;
+    }
+
+    /// Returns the data of the first section with the given name, looking in the main file first
+    /// and then in the companion file. Returns an empty view if there is no such section; throws
+    /// `LoaderError` if the companion file cannot be loaded or does not match the checksum
+    std::string_view section_data(const std::array<char, 4>& name) const;
+
+    /// Path to the companion file (empty if the file has no debug link)
+    std::string companion_path() const;
+
+private:
+    const MappedFile& companion() const;
+
+    const MappedFile& file;
+    const v0::Section* debug_link;
+    mutable std::once_flag companion_once;
+    mutable std::unique_ptr<MappedFile> companion_file;
+};
+
+
+} // namespace pex::loader
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <pex_loader/mapped_file.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+/// Hook converting code sections into the internal representation of the runtime
+struct SectionDecoder
+{
+    /// Sections with this name are decoded
+    std::array<char, 4> section_name;
+
+    /// Version of the decoded representation; cached sections decoded by another version are
+    /// decoded again
+    uint32_t version;
+
+    /// Decodes the data of a single section
+    std::function<std::string(std::string_view section_data)> decode;
+};
+
+
+/// Decoded code sections of a loaded file, cached in a sidecar file next to it
+///
+/// The sidecar is mapped read-only, so when it is up to date nothing is decoded at all. Otherwise
+/// the missing sections are decoded and the sidecar is rewritten atomically (via a temporary file
+/// and `rename(2)`), so concurrent loaders never see a partially written cache.
+///
+/// Sidecar layout (all integers are big-endian):
+///
+///     u8  magic[4] = "PEXC"
+///     u32 decoder_version
+///     u64 device, inode, file_size, modification_time_ns, image_offset
+///     u64 entry_count
+///     {
+///         u64 section_index; u64 section_offset; u64 source_size; u8 content_digest[32];
+///         u64 offset; u64 size
+///     } entries[entry_count]
+///     u8  decoded_data[]   (every entry starts at a 16-byte aligned file offset)
+///
+/// While the file is the one the sidecar was written for (same device, inode, size, modification
+/// time and image offset), entries are matched by section index and location, so loading reads
+/// neither the code sections nor hashes them. Once the file is rebuilt, the entries are matched by
+/// the `content_digest` and the size of the section data instead, so the sidecar stays valid for
+/// the sections which did not change, and a crafted section cannot be made to pick up the decoded
+/// data of another one.
+///
+/// The file must outlive the decoded sections.
+class DecodedSections
+{
+public:
+    /// Loads the decoded sections of `file`, using the sidecar at `sidecar_path` (empty means
+    /// `default_sidecar_path(file)`). If the sidecar cannot be written, the decoded sections are
+    /// kept in memory. Throws whatever the decoder throws
+    DecodedSections(const MappedFile& file, const SectionDecoder& decoder, const std::string& sidecar_path = "");
+
+    DecodedSections(const DecodedSections&) = delete;
+    DecodedSections& operator=(const DecodedSections&) = delete;
+
+    /// Returns the decoded data of a section of the file; throws `LoaderError` if the section was
+    /// not decoded
+    std::string_view decoded(const v0::Section& section) const;
+
+    /// Number of sections which had to be decoded while loading
+    size_t decoded_count() const
+    {
+        return decode_count;
+    }
+
+    /// Path of the file with `.decoded` appended; modules of a bundle (images which do not start the
+    /// mapping) get their image offset appended as well, so that each of them has its own sidecar
+    static std::string default_sidecar_path(const MappedFile& file);
+
+private:
+    const MappedFile& file;
+    std::shared_ptr<const FileMapping> sidecar;
+    std::vector<std::string> owned;
+
+    /// Decoded data indexed like `file.sections()`; null data for sections which are not code
+    std::vector<std::string_view> views;
+    size_t decode_count;
+};
+
+
+} // namespace pex::loader
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <string>
+#include <string_view>
+
+
+namespace pex::loader
+{
+
+/// Builds a delta transforming the PEX file `old_data` into `new_data`
+///
+/// Delta layout (all integers are big-endian):
+///
+///     u8  magic[4] = "PEXD"
+///     u32 delta_version = 2
+///     u64 old_size
+///     u64 new_size
+///     u64 op_count
+///     ops[op_count]:
+///         u8 kind = 0 (copy);   u64 old_offset; u64 size; u64 hash (`content_hash` of the old range)
+///         u8 kind = 1 (insert); u64 size; u8 data[size]
+///
+/// Sections of the new file which are present unchanged (same name and contents) in the old one
+/// become copies of the old file's byte range; everything else is carried literally. Only format
+/// major version 0 files are supported.
+std::string make_delta(std::string_view old_data, std::string_view new_data);
+
+/// Applies the delta to the file at `old_path`, writing the result to `new_path`
+///
+/// The old file must have the size recorded in the delta, and each range copied from it must match
+/// its recorded hash; bytes of the old file that are not copied are not read. The result is written to a
+/// temporary file next to `new_path`, synced and renamed over it, so `new_path` may be `old_path`
+/// and is left untouched on failure. Copies are performed with `copy_file_range`, so unchanged
+/// sections are not duplicated in memory (and may even be shared on file systems supporting
+/// reflinks). Throws `LoaderError` on failure.
+void apply_delta(const std::string& old_path, std::string_view delta, const std::string& new_path);
+
+
+} // namespace pex::loader
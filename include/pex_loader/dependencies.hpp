@@ -0,0 +1,73 @@
+#pragma once
+
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+namespace v0
+{
+    /// Name of the section listing the libraries imported by a module
+    constexpr auto import_section_name = section_name("IMPT");
+
+    /// Reads an import table section; throws `LoaderError` if it is malformed
+    ///
+    /// Section layout (all integers are in the byte order of the file):
+    ///
+    ///     u32 import_count
+    ///     { u32 name_size; u8 name[name_size] } imports[import_count]
+    ///
+    /// The returned views point into the section data.
+    std::vector<std::string_view> read_imports(std::string_view section_data, ByteOrder order = ByteOrder::big);
+
+    std::string write_imports(const std::vector<std::string_view>& imports, ByteOrder order = ByteOrder::big);
+}
+
+
+/// Loaded module together with its direct imports
+struct LoadedModule
+{
+    std::string name;
+    std::shared_ptr<const MappedFile> file;
+    std::vector<std::string> imports;
+};
+
+
+/// Loads a module and all the libraries it transitively imports
+///
+/// The import graph is discovered by a pool of `thread_count` workers sharing a queue: a library
+/// is queued as soon as the first module importing it has been loaded, without waiting for the
+/// rest of its level, and a library imported along several paths is loaded only once.
+class DependencyResolver
+{
+public:
+    /// Maps an imported library name to the path of its PEX file
+    using Locator = std::function<std::string(const std::string& name)>;
+
+    /// `thread_count` of 0 means `std::thread::hardware_concurrency()`
+    explicit DependencyResolver(Locator locator, const LoadOptions& options = {}, size_t thread_count = 0);
+
+    /// Loads the module at `path` and its dependencies; throws `LoaderError` if any of them cannot
+    /// be loaded. The result is keyed by module name, the root module being named `root_name`
+    std::map<std::string, LoadedModule> resolve(const std::string& root_name, const std::string& path) const;
+
+private:
+    LoadedModule load(const std::string& name, const std::string& path) const;
+
+    Locator locator;
+    LoadOptions options;
+    size_t thread_count;
+};
+
+
+} // namespace pex::loader
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+
+/// Implementation details shared between pex-loader components
+namespace pex::loader::detail
+{
+
+/// Loads a big-endian unsigned integer from a (possibly unaligned) pointer
+///
+/// The caller is responsible for checking that at least `sizeof(T)` bytes are available.
+template <typename T>
+inline T load_be(const char* ptr)
+{
+    static_assert(std::is_unsigned_v<T>, "Only unsigned integers are supported");
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value = T((value << 8) | T(uint8_t(ptr[i])));
+    }
+    return value;
+}
+
+/// Stores a big-endian unsigned integer to a (possibly unaligned) pointer
+template <typename T>
+inline void store_be(char* ptr, T value)
+{
+    static_assert(std::is_unsigned_v<T>, "Only unsigned integers are supported");
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        ptr[i] = char(uint8_t(value >> ((sizeof(T) - 1 - i) * 8)));
+    }
+}
+
+/// Reverses the byte order of an unsigned integer
+template <typename T>
+constexpr T byte_swap(T value)
+{
+    static_assert(std::is_unsigned_v<T>, "Only unsigned integers are supported");
+    if constexpr (sizeof(T) == 1) {
+        return value;
+    } else if constexpr (sizeof(T) == 2) {
+        return __builtin_bswap16(value);
+    } else if constexpr (sizeof(T) == 4) {
+        return __builtin_bswap32(value);
+    } else {
+        static_assert(sizeof(T) == 8, "Unsupported integer size");
+        return __builtin_bswap64(value);
+    }
+}
+
+/// Loads an unsigned integer of the given byte order from a (possibly unaligned) pointer
+///
+/// When `Order` is the native byte order, this is a plain load.
+template <ByteOrder Order, typename T>
+inline T load(const char* ptr)
+{
+    T value;
+    std::memcpy(&value, ptr, sizeof(T));
+    if constexpr (Order != native_byte_order) {
+        value = byte_swap(value);
+    }
+    return value;
+}
+
+/// Stores an unsigned integer in the given byte order to a (possibly unaligned) pointer
+template <ByteOrder Order, typename T>
+inline void store(char* ptr, T value)
+{
+    if constexpr (Order != native_byte_order) {
+        value = byte_swap(value);
+    }
+    std::memcpy(ptr, &value, sizeof(T));
+}
+
+/// Appends an unsigned integer in the given byte order to the string
+template <ByteOrder Order, typename T>
+inline void append(std::string& out, T value)
+{
+    char bytes[sizeof(T)];
+    store<Order, T>(bytes, value);
+    out.append(bytes, sizeof(T));
+}
+
+/// Loads an unsigned integer of a byte order only known at run time
+template <typename T>
+inline T load(ByteOrder order, const char* ptr)
+{
+    auto value = load<native_byte_order, T>(ptr);
+    return order == native_byte_order ? value : byte_swap(value);
+}
+
+/// Appends an unsigned integer of a byte order only known at run time to the string
+template <typename T>
+inline void append(ByteOrder order, std::string& out, T value)
+{
+    if (order == ByteOrder::little) {
+        append<ByteOrder::little, T>(out, value);
+    } else {
+        append<ByteOrder::big, T>(out, value);
+    }
+}
+
+/// Appends a big-endian unsigned integer to the string
+template <typename T>
+inline void append_be(std::string& out, T value)
+{
+    static_assert(std::is_unsigned_v<T>, "Only unsigned integers are supported");
+    for (size_t i = sizeof(T); i > 0; --i) {
+        out.push_back(char(uint8_t(value >> ((i - 1) * 8))));
+    }
+}
+
+} // namespace pex::loader::detail
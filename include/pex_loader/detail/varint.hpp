@@ -0,0 +1,83 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdint>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace pex::loader::detail
+{
+
+/// Adds the next byte of a ULEB128 value to `value`, `shift` being 0 for the first byte; returns
+/// true if more bytes follow. Throws `LoaderError` on overflow
+///
+/// This is the step shared by the decoders of whole buffers and of streamed data.
+inline bool uleb128_step(uint64_t& value, unsigned& shift, uint8_t byte)
+{
+    // The 10th byte may only hold the top bit, and so cannot be followed by another one
+    if (shift == 63 && byte > 1) {
+        throw LoaderError("Varint is too large");
+    }
+    value |= uint64_t(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+        return false;
+    }
+    shift += 7;
+    return true;
+}
+
+/// Decodes a single ULEB128 value, advancing `ptr`; throws `LoaderError` on EOF or overflow
+inline uint64_t decode_uleb128(const char*& ptr, const char* end)
+{
+    uint64_t value = 0;
+    unsigned shift = 0;
+    do {
+        if (ptr == end) {
+            throw LoaderError("Unexpected EOF while decoding a varint");
+        }
+    } while (uleb128_step(value, shift, uint8_t(*ptr++)));
+    return value;
+}
+
+/// Decodes `count` consecutive ULEB128 values into `out`, advancing `ptr`
+///
+/// Runs of single-byte values (the common case for small sizes and indices) are detected 16 bytes
+/// at a time with SSE2 and copied without per-byte branches.
+inline void decode_uleb128(const char*& ptr, const char* end, uint64_t* out, size_t count)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    while (count - i >= 16 && end - ptr >= 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+        auto continuation_mask = unsigned(_mm_movemask_epi8(chunk));
+        auto single_bytes = continuation_mask == 0 ? 16u : unsigned(__builtin_ctz(continuation_mask));
+        for (unsigned j = 0; j < single_bytes; ++j) {
+            out[i + j] = uint8_t(ptr[j]);
+        }
+        i += single_bytes;
+        ptr += single_bytes;
+        if (single_bytes != 16) {
+            out[i++] = decode_uleb128(ptr, end);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = decode_uleb128(ptr, end);
+    }
+}
+
+inline void append_uleb128(std::string& out, uint64_t value)
+{
+    do {
+        auto byte = uint8_t(value & 0x7F);
+        value >>= 7;
+        out.push_back(char(value != 0 ? (byte | 0x80) : byte));
+    } while (value != 0);
+}
+
+} // namespace pex::loader::detail
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <pex_loader/detail/byte_order.hpp>
+#include <pex_loader/detail/varint.hpp>
+#include <pex_loader/pex_loader.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+namespace detail
+{
+    /// Throws a `LoaderError` describing why the encoded size of a v0 section is invalid
+    ///
+    /// Kept out of line, so that the section walk only contains the check.
+    [[noreturn]] void throw_section_size_error(
+        uint64_t index,
+        uint64_t header_offset,
+        uint64_t encoded_size,
+        uint64_t data_size
+    );
+
+    /// Reads and validates the 12-byte header of a section of an interleaved table (version 0 and
+    /// plain version 1 tables) at `header_offset`, in a file of `data_size` bytes after the early
+    /// header; `index` is only used in error messages
+    ///
+    /// The header must be within the file (`header_offset + 12 <= data_size`).
+    template <ByteOrder Order>
+    v0::Section read_section_header(const char* header, uint64_t index, uint64_t header_offset, uint64_t data_size)
+    {
+        auto encoded_size = load<Order, uint64_t>(header);
+
+        // The checks are combined without short-circuiting, so the common case takes a single
+        // well-predicted branch; the precise error is only worked out on failure
+        v0::Section section;
+        static_assert(section.name.size() == 4, "Section name length must be equal to 4");
+        section.offset = header_offset + 12;
+        uint64_t data_end;
+        bool invalid = __builtin_sub_overflow(encoded_size, uint64_t(4), &section.size);
+        invalid |= __builtin_add_overflow(section.offset, section.size, &data_end);
+        invalid |= data_end > data_size;
+        if (__builtin_expect(invalid, 0)) {
+            throw_section_size_error(index, header_offset, encoded_size, data_size);
+        }
+        std::memcpy(section.name.data(), header + 8, section.name.size());
+        return section;
+    }
+
+    /// Validates an entry of a compact section table (see `v1::compact_table`) and lays the section
+    /// out at `offset`, which is advanced past it; `names` holds `name_count` 4-byte names
+    inline v0::Section read_compact_entry(
+        uint64_t name_index,
+        uint64_t size,
+        const char* names,
+        uint64_t name_count,
+        uint64_t& offset,
+        uint64_t data_size
+    )
+    {
+        if (name_index >= name_count) {
+            throw LoaderError("Section name index out of range: " + std::to_string(name_index));
+        }
+        if (size > data_size - offset) {
+            throw LoaderError("Unexpected EOF while reading section data");
+        }
+        v0::Section section;
+        std::memcpy(section.name.data(), names + name_index * 4, section.name.size());
+        section.offset = offset;
+        section.size = size;
+        offset += size;
+        return section;
+    }
+
+    constexpr uint64_t footer_size = 20;
+    constexpr uint64_t footer_entry_size = 20;
+
+    /// Location of a footer section table (see `v1::footer_table`)
+    struct Footer
+    {
+        uint64_t table_offset;
+        uint64_t section_count;
+    };
+
+    /// Reads and validates the footer of a file of `data_size` bytes (after the early header)
+    template <ByteOrder Order>
+    Footer read_footer(const char* footer, uint64_t data_size)
+    {
+        if (data_size < 4 + footer_size) {
+            throw LoaderError("Unexpected EOF while reading section table footer");
+        }
+        if (std::string_view(footer + 16, 4) != "PEXF") {
+            throw LoaderError("Invalid section table footer magic");
+        }
+        auto table_offset = load<Order, uint64_t>(footer);
+        auto section_count = load<Order, uint64_t>(footer + 8);
+
+        auto table_end = data_size - footer_size;
+        if (
+            table_offset < 4
+            || table_offset > table_end
+            || section_count > (table_end - table_offset) / footer_entry_size
+        ) {
+            throw LoaderError("Section table is out of the file bounds");
+        }
+        return Footer{table_offset, section_count};
+    }
+
+    /// Reads and validates an entry of a footer section table
+    ///
+    /// Entries must be sorted by offset and must not overlap, so that the sections can be looked
+    /// up by offset; `previous_end` is the end of the previous section (initially 4) and is
+    /// advanced past this one.
+    template <ByteOrder Order>
+    v0::Section read_footer_entry(const char* entry, uint64_t table_offset, uint64_t& previous_end)
+    {
+        v0::Section section;
+        section.offset = load<Order, uint64_t>(entry);
+        section.size = load<Order, uint64_t>(entry + 8);
+        std::memcpy(section.name.data(), entry + 16, section.name.size());
+        if (section.offset > table_offset || section.size > table_offset - section.offset) {
+            throw LoaderError("Section is out of the file bounds");
+        }
+        if (section.offset < previous_end) {
+            throw LoaderError("Footer section table entries overlap or are not sorted by offset");
+        }
+        previous_end = section.offset + section.size;
+        return section;
+    }
+}
+
+
+namespace v0
+{
+    /// Walks the section table, calling `callback(const Section&)` for every section
+    ///
+    /// This is the parse loop behind `read_sections`. It is a template so that the callback is
+    /// inlined into the loop.
+    template <typename Callback>
+    void for_each_section(std::string_view data, Callback&& callback)
+    {
+        using detail::load_be;
+
+        const uint64_t data_size = data.size();
+        if (data_size < 8) {
+            throw LoaderError("Unexpected EOF while reading section count");
+        }
+        auto section_count = load_be<uint64_t>(data.data());
+
+        uint64_t offset = 8;
+        for (decltype(section_count) i = 0; i < section_count; ++i) {
+            // `offset` never exceeds `data_size`, so this cannot overflow
+            uint64_t header_end = offset + 12;
+            if (__builtin_expect(header_end > data_size, 0)) {
+                throw LoaderError(
+                    "Unexpected EOF while reading header of section " + std::to_string(i)
+                    + " at offset " + std::to_string(offset)
+                );
+            }
+            auto section = detail::read_section_header<ByteOrder::big>(data.data() + offset, i, offset, data_size);
+            offset = section.offset + section.size;
+            callback(section);
+        }
+    }
+}
+
+
+namespace v1
+{
+    /// Walks a section table encoded in the given byte order, starting at `table_offset` in `data`
+    template <ByteOrder Order, typename Callback>
+    void for_each_section_in(std::string_view data, uint64_t table_offset, Callback&& callback)
+    {
+        using detail::load;
+
+        if (table_offset > data.size() || data.size() - table_offset < 8) {
+            throw LoaderError("Unexpected EOF while reading section count");
+        }
+        auto section_count = load<Order, uint64_t>(data.data() + table_offset);
+
+        uint64_t offset = table_offset + 8;
+        for (decltype(section_count) i = 0; i < section_count; ++i) {
+            if (data.size() - offset < 12) {
+                throw LoaderError("Unexpected EOF while reading section header");
+            }
+            auto section = detail::read_section_header<Order>(data.data() + offset, i, offset, data.size());
+            offset = section.offset + section.size;
+
+            callback(section);
+        }
+    }
+
+    /// Walks a compact section table (see `compact_table`) starting at `table_offset` in `data`
+    template <typename Callback>
+    void for_each_compact_section_in(std::string_view data, uint64_t table_offset, Callback&& callback)
+    {
+        if (table_offset > data.size()) {
+            throw LoaderError("Unexpected EOF while reading section table");
+        }
+        const char* ptr = data.data() + table_offset;
+        const char* end = data.data() + data.size();
+
+        auto section_count = detail::decode_uleb128(ptr, end);
+        auto name_count = detail::decode_uleb128(ptr, end);
+        if (name_count > uint64_t(end - ptr) / 4) {
+            throw LoaderError("Unexpected EOF while reading section names");
+        }
+        const char* names = ptr;
+        ptr += name_count * 4;
+
+        // Every entry takes at least two bytes, which bounds the allocation below by the table size
+        if (section_count > uint64_t(end - ptr) / 2) {
+            throw LoaderError("Unexpected EOF while reading section table");
+        }
+
+        // The entries are decoded in a single pass. The offset of the data is only known after all of
+        // them, so they are kept until then: on the stack for small tables, on the heap otherwise
+        constexpr size_t inline_count = 256;
+        uint64_t inline_entries[inline_count * 2];
+        std::vector<uint64_t> heap_entries;
+        uint64_t* entries = inline_entries;
+        if (section_count > inline_count) {
+            heap_entries.resize(size_t(section_count) * 2);
+            entries = heap_entries.data();
+        }
+        detail::decode_uleb128(ptr, end, entries, size_t(section_count) * 2);
+        uint64_t offset = uint64_t(ptr - data.data());
+
+        for (uint64_t i = 0; i < section_count; ++i) {
+            auto section = detail::read_compact_entry(
+                entries[i * 2],
+                entries[i * 2 + 1],
+                names,
+                name_count,
+                offset,
+                data.size()
+            );
+            callback(section);
+        }
+    }
+
+    /// Walks a footer-indexed section table (see `footer_table`)
+    template <ByteOrder Order, typename Callback>
+    void for_each_footer_section_in(std::string_view data, Callback&& callback)
+    {
+        using detail::footer_size;
+        using detail::footer_entry_size;
+
+        if (data.size() < footer_size) {
+            throw LoaderError("Unexpected EOF while reading section table footer");
+        }
+        auto footer = detail::read_footer<Order>(data.data() + data.size() - footer_size, data.size());
+
+        const char* entry = data.data() + footer.table_offset;
+        uint64_t previous_end = 4;
+        for (uint64_t i = 0; i < footer.section_count; ++i, entry += footer_entry_size) {
+            auto section = detail::read_footer_entry<Order>(entry, footer.table_offset, previous_end);
+            callback(section);
+        }
+    }
+
+    /// Walks the section table, calling `callback(const Section&)` for every section
+    ///
+    /// The feature flags are checked once, and the walk itself is instantiated for each table
+    /// encoding and byte order, so reading a table in the native byte order involves no byte
+    /// swapping.
+    template <typename Callback>
+    void for_each_section(std::string_view data, Callback&& callback)
+    {
+        auto flags = read_feature_flags(data);
+        if (flags & compact_table) {
+            for_each_compact_section_in(data, 4, std::forward<Callback>(callback));
+        } else if (flags & footer_table) {
+            if (byte_order(flags) == ByteOrder::little) {
+                for_each_footer_section_in<ByteOrder::little>(data, std::forward<Callback>(callback));
+            } else {
+                for_each_footer_section_in<ByteOrder::big>(data, std::forward<Callback>(callback));
+            }
+        } else if (byte_order(flags) == ByteOrder::little) {
+            for_each_section_in<ByteOrder::little>(data, 4, std::forward<Callback>(callback));
+        } else {
+            for_each_section_in<ByteOrder::big>(data, 4, std::forward<Callback>(callback));
+        }
+    }
+}
+
+
+/// Parser for a format major version
+///
+/// Every specialization provides `major_version`, and static `for_each_section(data, callback)`,
+/// `read_sections(data)` and `byte_order(data)` functions taking the part of the file after the
+/// early header.
+template <uint16_t MajorVersion>
+struct FormatParser;
+
+template <>
+struct FormatParser<0>
+{
+    static constexpr uint16_t major_version = 0;
+
+    template <typename Callback>
+    static void for_each_section(std::string_view data, Callback&& callback)
+    {
+        v0::for_each_section(data, std::forward<Callback>(callback));
+    }
+
+    static std::vector<v0::Section> read_sections(std::string_view data)
+    {
+        return v0::read_sections(data);
+    }
+
+    static ByteOrder byte_order(std::string_view)
+    {
+        return ByteOrder::big;
+    }
+};
+
+template <>
+struct FormatParser<1>
+{
+    static constexpr uint16_t major_version = 1;
+
+    template <typename Callback>
+    static void for_each_section(std::string_view data, Callback&& callback)
+    {
+        v1::for_each_section(data, std::forward<Callback>(callback));
+    }
+
+    static std::vector<v1::Section> read_sections(std::string_view data)
+    {
+        return v1::read_sections(data);
+    }
+
+    static ByteOrder byte_order(std::string_view data)
+    {
+        return v1::byte_order(v1::read_feature_flags(data));
+    }
+};
+
+
+/// Format major versions supported by `visit_format`
+using SupportedFormatVersions = std::integer_sequence<uint16_t, 0, 1>;
+
+
+namespace detail
+{
+    template <uint16_t FirstVersion, uint16_t... Versions>
+    constexpr uint16_t first_version(std::integer_sequence<uint16_t, FirstVersion, Versions...>)
+    {
+        return FirstVersion;
+    }
+
+    template <typename Visitor, uint16_t... Versions>
+    decltype(auto) visit_format(
+        uint16_t major_version,
+        Visitor&& visitor,
+        std::integer_sequence<uint16_t, Versions...> versions
+    )
+    {
+        using Result = std::invoke_result_t<Visitor, FormatParser<first_version(versions)>>;
+
+        bool found;
+        std::optional<std::conditional_t<std::is_void_v<Result>, bool, Result>> result;
+        if constexpr (std::is_void_v<Result>) {
+            found = ((major_version == Versions ? (visitor(FormatParser<Versions>{}), true) : false) || ...);
+        } else {
+            found = (
+                (major_version == Versions ? (result.emplace(visitor(FormatParser<Versions>{})), true) : false)
+                || ...
+            );
+        }
+
+        if (!found) {
+            throw LoaderError(
+                "Unsupported format major version: "
+                + std::to_string(static_cast<unsigned int>(major_version))
+            );
+        }
+        if constexpr (!std::is_void_v<Result>) {
+            return Result(std::move(*result));
+        }
+    }
+}
+
+
+/// Calls `visitor(FormatParser<major_version>{})` and returns its result
+///
+/// This is the only runtime dispatch on the format version: the visitor is instantiated for every
+/// supported version, so everything it does with the parser is resolved at compile time. Throws
+/// `LoaderError` for unsupported versions.
+template <typename Visitor>
+decltype(auto) visit_format(uint16_t major_version, Visitor&& visitor)
+{
+    return detail::visit_format(major_version, std::forward<Visitor>(visitor), SupportedFormatVersions{});
+}
+
+
+/// Reads the section table of a whole PEX file of any supported format version
+std::vector<v0::Section> read_file_sections(std::string_view data);
+
+
+} // namespace pex::loader
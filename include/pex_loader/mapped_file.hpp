@@ -0,0 +1,368 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+class ModuleCacheClient;
+class SectionStore;
+
+
+/// Read-only memory mapping of a whole file
+///
+/// The file descriptor is kept open for the lifetime of the mapping, so that it can be used for
+/// I/O hints and additional mappings of the same file.
+class FileMapping
+{
+public:
+    /// Opens and maps the file; throws `LoaderError` on failure
+    ///
+    /// With `huge_page_aligned`, files of at least `huge_page_size` are placed at a huge page
+    /// boundary, so that file offsets aligned to `huge_page_size` are aligned in memory as well.
+    explicit FileMapping(const std::string& path, bool huge_page_aligned = false);
+
+    /// Maps the file open as `fd`, taking ownership of the descriptor; `path` is only reported
+    FileMapping(const std::string& path, int fd, bool huge_page_aligned = false);
+    ~FileMapping();
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    std::string_view data() const
+    {
+        return std::string_view(ptr, length);
+    }
+
+    int fd() const
+    {
+        return file_descriptor;
+    }
+
+    const std::string& path() const
+    {
+        return file_path;
+    }
+
+private:
+    std::string file_path;
+    int file_descriptor;
+    char* ptr;
+    size_t length;
+};
+
+
+/// Anonymous memory region holding a private copy of some data
+class AnonymousBuffer
+{
+public:
+    /// Allocates `size` bytes (rounded up to `alignment`) aligned to `alignment`, which must be a
+    /// multiple of the page size; throws `LoaderError` on failure
+    AnonymousBuffer(size_t size, size_t alignment);
+    ~AnonymousBuffer();
+
+    AnonymousBuffer(const AnonymousBuffer&) = delete;
+    AnonymousBuffer& operator=(const AnonymousBuffer&) = delete;
+
+    char* data() const
+    {
+        return ptr;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    /// Bytes actually reserved for the buffer
+    size_t capacity() const
+    {
+        return mapped_length;
+    }
+
+    /// Write-protects the buffer
+    void make_read_only();
+
+private:
+    char* ptr;
+    size_t length;
+    size_t mapped_length;
+};
+
+
+/// Writable private view of a section's data
+///
+/// Either a copy-on-write mapping of the file, whose pages are only copied when written, or an
+/// anonymous copy of the data. Writes are never visible to the file or to other views.
+class WritableSection
+{
+public:
+    ~WritableSection();
+
+    WritableSection(const WritableSection&) = delete;
+    WritableSection& operator=(const WritableSection&) = delete;
+
+    char* data() const
+    {
+        return ptr;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    /// Returns true if the view maps the file rather than holding a copy of it
+    bool is_copy_on_write() const
+    {
+        return copy_on_write;
+    }
+
+private:
+    friend class MappedFile;
+
+    WritableSection(char* mapping, size_t mapping_length, char* ptr, size_t length, bool copy_on_write);
+
+    char* mapping;
+    size_t mapping_length;
+    char* ptr;
+    size_t length;
+    bool copy_on_write;
+};
+
+
+/// Size of a transparent huge page on the supported platforms
+constexpr size_t huge_page_size = size_t(2) << 20;
+
+
+/// Access pattern hint for a memory range, see `madvise(2)`
+enum class AccessAdvice
+{
+    normal,
+    will_need,
+    dont_need,
+    sequential,
+    random,
+};
+
+
+/// Options controlling how a PEX file is loaded
+struct LoadOptions
+{
+    /// Advice applied to the whole file right after it is mapped
+    AccessAdvice file_advice = AccessAdvice::normal;
+
+    /// Sections which are prefetched right after the file is loaded
+    std::vector<std::array<char, 4>> prefetch_sections;
+
+    /// Sections of at least this size are placed in memory eligible for transparent huge pages
+    /// (0 disables this)
+    ///
+    /// Values below `huge_page_size` are raised to it, since smaller sections cannot fill a huge
+    /// page. Sections whose file offset is aligned to `huge_page_size` are advised in place, others
+    /// are copied into an aligned anonymous buffer.
+    uint64_t huge_page_threshold = 0;
+
+    /// Sections of at least this size are deduplicated by contents through `section_store`
+    /// (0 disables this)
+    ///
+    /// Such sections are served from a shared read-only buffer, and their pages of the mapped file
+    /// are released. Sections placed on huge pages are not deduplicated.
+    uint64_t deduplication_threshold = 0;
+
+    /// Store used for deduplication; `nullptr` means `SectionStore::global()`
+    SectionStore* section_store = nullptr;
+
+    /// Broker client through which section copies are shared between processes (`nullptr` keeps
+    /// them private to the process)
+    ///
+    /// The file itself is always mapped directly, since its page cache is already shared. Only the
+    /// copies made while loading it are published: the first process making a huge page copy of a
+    /// section publishes it, keyed by the device, inode, size and modification time of the file and
+    /// by the section, and deduplicated sections are published by contents. Every other process maps
+    /// the published copy instead of making its own. If the broker cannot be reached, the copies
+    /// are made privately.
+    ModuleCacheClient* module_cache = nullptr;
+
+    /// Record the order in which sections are first accessed, see `MappedFile::access_trace`
+    bool trace_access = false;
+};
+
+
+/// Memory used by a single section of a loaded file
+struct SectionMemoryUsage
+{
+    /// Bytes of the file mapping spanned by the section's pages
+    uint64_t mapped_bytes;
+    /// Bytes of the memory currently backing the section which are resident (see `mincore(2)`)
+    uint64_t resident_bytes;
+    /// Bytes allocated for a private or deduplicated copy of the section
+    uint64_t copy_bytes;
+    /// True if the copy is shared with other modules (through a `SectionStore`) or with other
+    /// processes (through `LoadOptions::module_cache`)
+    bool shared_copy;
+};
+
+
+/// Memory used by a loaded file
+struct MemoryUsage
+{
+    /// Bytes of the file mapping occupied by the PEX image
+    uint64_t mapped_bytes;
+    /// Resident bytes of the image mapping and of the section copies
+    uint64_t resident_bytes;
+    /// Heap bytes of the parsed tables plus the bytes of all section copies (shared copies are
+    /// counted in every module using them)
+    uint64_t heap_bytes;
+    /// Per-section breakdown, indexed like `MappedFile::sections()`
+    std::vector<SectionMemoryUsage> sections;
+};
+
+
+/// PEX file mapped into memory, with its early header and section table parsed
+class MappedFile
+{
+public:
+    /// Maps and parses the file at `path`; throws `LoaderError` on failure
+    explicit MappedFile(const std::string& path, const LoadOptions& options = {});
+
+    /// Parses a PEX image located inside an existing mapping
+    MappedFile(
+        std::shared_ptr<const FileMapping> mapping,
+        std::string_view image,
+        const LoadOptions& options = {}
+    );
+
+    ~MappedFile();
+
+    const EarlyHeaderInfo& header() const
+    {
+        return header_info;
+    }
+
+    const std::vector<v0::Section>& sections() const
+    {
+        return section_table;
+    }
+
+    /// Byte order of the section table and of numeric section data
+    ByteOrder byte_order() const
+    {
+        return file_byte_order;
+    }
+
+    /// Whole PEX image, starting with the early header
+    std::string_view data() const
+    {
+        return image;
+    }
+
+    const FileMapping& mapping() const
+    {
+        return *file_mapping;
+    }
+
+    /// Returns the data of a section from `sections()`
+    ///
+    /// This may point to a private copy of the section rather than to the mapped file.
+    std::string_view section_data(const v0::Section& section) const;
+
+    /// Returns the offset of the section's data in the mapped file
+    uint64_t file_offset(const v0::Section& section) const;
+
+    /// Returns true if the section is served from a private or shared copy instead of the mapping
+    bool is_copied(const v0::Section& section) const;
+
+    /// Returns indices of the sections accessed through `section_data`, in the order of their first
+    /// access (empty unless the file was loaded with `LoadOptions::trace_access`)
+    std::vector<size_t> access_trace() const;
+
+    /// Returns how many bytes of the memory backing the section are actually on huge pages
+    ///
+    /// The value comes from `/proc/self/smaps` and is per memory area, so it is capped by the
+    /// section size and may include neighbouring data of the same area. Returns 0 if the platform
+    /// does not report it.
+    uint64_t huge_page_bytes(const v0::Section& section) const;
+
+    /// Returns the index in `sections()` of a section of the file (a reference into `sections()`
+    /// or a copy of one); throws `LoaderError` if the file has no such section
+    size_t index_of(const v0::Section& section) const;
+
+    /// Returns the first section with the given name, or `nullptr` if there is none
+    const v0::Section* find_section(const std::array<char, 4>& name) const;
+
+    /// Reports how much memory the file costs, broken down per section
+    MemoryUsage memory_usage() const;
+
+    /// Returns a writable private view of the section, e.g. for mutable data sections
+    ///
+    /// Sections served from the mapped file are mapped with `MAP_PRIVATE` over the pages they
+    /// span, so untouched pages keep being shared with the page cache. Sections smaller than a
+    /// page and sections which already have a private or shared copy are copied instead.
+    ///
+    /// As with any private file mapping, pages which have not been written yet may reflect later
+    /// modifications of the file.
+    std::unique_ptr<WritableSection> map_writable(const v0::Section& section) const;
+
+    /// Applies the advice to the pages spanned by the section
+    ///
+    /// `dont_need` is ignored for sections which have a private copy, since it would discard it.
+    void advise(const v0::Section& section, AccessAdvice advice) const;
+
+    /// Asks the kernel to read the section's pages ahead of their first access
+    void prefetch(const v0::Section& section) const
+    {
+        advise(section, AccessAdvice::will_need);
+    }
+
+    /// Tells the kernel that the section's pages are not going to be accessed soon
+    void release(const v0::Section& section) const
+    {
+        advise(section, AccessAdvice::dont_need);
+    }
+
+private:
+    /// Memory holding a copy of a section's data, used instead of the mapping
+    struct SectionCopy
+    {
+        /// Keeps the memory alive: an `AnonymousBuffer`, or a mapping of a buffer shared between
+        /// processes (null if the section is not copied)
+        std::shared_ptr<const void> owner;
+        const char* data = nullptr;
+        size_t size = 0;
+        /// Bytes reserved for the copy
+        size_t capacity = 0;
+        /// Published through the module cache
+        bool cross_process = false;
+    };
+
+    void load(const LoadOptions& options);
+    std::string_view backing_data(size_t index) const;
+    std::string_view mapped_section_data(const v0::Section& section) const;
+    std::string cache_key(size_t index) const;
+    void use_huge_pages(size_t index, ModuleCacheClient* module_cache);
+    void deduplicate(size_t index, SectionStore& store, ModuleCacheClient* module_cache);
+
+    std::shared_ptr<const FileMapping> file_mapping;
+    std::string_view image;
+    EarlyHeaderInfo header_info;
+    ByteOrder file_byte_order;
+    std::vector<v0::Section> section_table;
+
+    /// Copies of sections, indexed like `section_table`
+    std::vector<SectionCopy> section_copies;
+
+    struct AccessTrace;
+    std::unique_ptr<AccessTrace> trace;
+};
+
+
+} // namespace pex::loader
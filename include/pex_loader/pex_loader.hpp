@@ -44,7 +44,23 @@ struct EarlyHeaderInfo
     FormatVersion format_version;
 };
 
+/// Byte order of the integers in a PEX file
+enum class ByteOrder
+{
+    big,
+    little,
+};
+
+/// Byte order of the target platform
+constexpr ByteOrder native_byte_order = (
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? ByteOrder::little : ByteOrder::big
+);
+
+/// Size of the early header, which is followed by the version-specific part of the file
+constexpr size_t early_header_size = 8;
+
 EarlyHeaderInfo read_early_header(const std::string_view& data);
+std::string write_early_header(const EarlyHeaderInfo& info);
 
 
 /// Format major version 0
@@ -58,7 +74,86 @@ namespace v0
         std::array<char, 4> name;
     };
 
+    /// Makes a section name from a 4-character string literal
+    constexpr std::array<char, 4> section_name(const char (&name)[5])
+    {
+        return {name[0], name[1], name[2], name[3]};
+    }
+
+    /// Name and data of a section to be written
+    struct SectionContents
+    {
+        std::array<char, 4> name;
+        std::string_view data;
+    };
+
+    std::vector<Section> read_sections(const std::string_view& data);
+    std::string write_sections(const std::vector<SectionContents>& sections);
+
+    /// Rewrites the section table so that the sections with the given indices come first, in the
+    /// given order, followed by the rest of the sections in their original order
+    ///
+    /// Relocation sections (see `relocation_section_name`) are rewritten to target the moved sections.
+    std::string reorder_sections(const std::string_view& data, const std::vector<size_t>& hot_sections);
+}
+
+
+/// Format major version 1
+///
+/// The part of the file after the early header starts with a big-endian u32 of feature flags,
+/// followed by a section table laid out as in version 0 but encoded according to the flags.
+namespace v1
+{
+    using Section = v0::Section;
+    using SectionContents = v0::SectionContents;
+
+    /// Optional features of a version 1 file
+    enum FeatureFlags : uint32_t
+    {
+        /// Integers of the section table and of numeric data in sections (including the fields
+        /// patched by relocations) are little-endian
+        ///
+        /// This includes the typed sections defined by this library (symbol, string, relocation and
+        /// import tables, constant pools and debug links), whose readers and writers take the byte
+        /// order of the file.
+        little_endian = 1u << 0,
+
+        /// The section table is stored compactly in front of the section data:
+        ///
+        ///     uleb128 section_count
+        ///     uleb128 name_count
+        ///     u8      names[name_count][4]
+        ///     { uleb128 name_index; uleb128 size } entries[section_count]
+        ///     u8      data[]    (contents of all the sections, in order)
+        compact_table = 1u << 1,
+
+        /// Sections are stored one after another right after the flags, and the table is stored
+        /// at the end of the file, so that writers can stream sections as they are produced:
+        ///
+        ///     u8 data[]
+        ///     { u64 offset; u64 size; u8 name[4] } entries[section_count]
+        ///     u64 table_offset
+        ///     u64 section_count
+        ///     u8  magic[4] = "PEXF"
+        ///
+        /// Offsets are relative to the feature flags. Cannot be combined with `compact_table`.
+        footer_table = 1u << 2,
+    };
+
+    /// All the feature flags known to this version of the library
+    constexpr uint32_t supported_feature_flags = little_endian | compact_table | footer_table;
+
+    /// Reads and validates the feature flags at the start of `data`
+    uint32_t read_feature_flags(const std::string_view& data);
+
+    constexpr ByteOrder byte_order(uint32_t feature_flags)
+    {
+        return (feature_flags & little_endian) ? ByteOrder::little : ByteOrder::big;
+    }
+
+    /// Reads the section table; offsets are relative to `data`, which includes the feature flags
     std::vector<Section> read_sections(const std::string_view& data);
+    std::string write_sections(uint32_t feature_flags, const std::vector<SectionContents>& sections);
 }
 
 
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <pex_loader/mapped_file.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+/// Background threads warming the page cache for sections which are going to be needed soon
+///
+/// Requests are deduplicated: page ranges of a file which are already queued or being read are not
+/// queued again. Ranges which have been warmed can be requested again, since their pages may have
+/// been evicted since. The total size of queued and in-progress reads is capped; sections which do
+/// not fit are dropped, since prefetching is only a hint.
+class Prefetcher
+{
+public:
+    /// With a `thread_count` of 0 no thread is started, and queued requests are only processed by
+    /// `wait_idle` on the calling thread
+    explicit Prefetcher(uint64_t max_in_flight_bytes = uint64_t(64) << 20, size_t thread_count = 1);
+
+    /// Stops the threads; queued requests are dropped
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    /// Queues the sections for warming; returns the number of bytes queued
+    uint64_t request(const std::shared_ptr<const MappedFile>& file, const std::vector<v0::Section>& sections);
+
+    /// Blocks until all the queued requests are processed (processing them itself if the prefetcher
+    /// has no threads)
+    void wait_idle();
+
+    /// Bytes queued or being read right now
+    uint64_t in_flight_bytes() const;
+
+private:
+    struct Task
+    {
+        std::shared_ptr<const MappedFile> file;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct FileState
+    {
+        std::weak_ptr<const MappedFile> file;
+        /// Disjoint page ranges which are queued or being read, keyed by their start
+        std::map<uint64_t, uint64_t> ranges;
+    };
+
+    void run();
+    /// Warms the first queued task, unlocking `lock` meanwhile
+    void process_next(std::unique_lock<std::mutex>& lock);
+    static void warm(const Task& task);
+    void purge_expired();
+
+    uint64_t max_in_flight_bytes;
+
+    mutable std::mutex mutex;
+    std::condition_variable has_work;
+    std::condition_variable idle;
+    std::deque<Task> queue;
+    uint64_t in_flight;
+    size_t busy_threads;
+    bool stopping;
+    std::map<const MappedFile*, FileState> files;
+
+    std::vector<std::thread> threads;
+};
+
+
+} // namespace pex::loader
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+namespace v0
+{
+    /// Name of the section holding the relocations of a file
+    ///
+    /// Its groups refer to sections by their index in the file's section table, so tools which
+    /// renumber sections must rewrite it with `remap_relocation_table`.
+    constexpr auto relocation_section_name = section_name("RELO");
+
+    /// Kind of a fix-up applied to section data
+    enum class RelocationType : uint32_t
+    {
+        /// Adds the displacement to a 64-bit field
+        add64 = 0,
+        /// Adds the displacement (truncated to 32 bits) to a 32-bit field
+        add32 = 1,
+    };
+
+    /// Single relocation, as produced by a writer
+    struct Relocation
+    {
+        uint32_t section_index;
+        RelocationType type;
+        uint64_t offset;
+    };
+
+    /// Read-only view of a relocation section
+    ///
+    /// Section layout (all fixed-size integers are in the byte order of the file, see
+    /// `MappedFile::byte_order`):
+    ///
+    ///     u32 group_count
+    ///     { u32 section_index; u32 type; u32 count; u32 data_offset; u32 data_size } groups[group_count]
+    ///     u8  data[]
+    ///
+    /// Groups are sorted by `(section_index, type)` and hold all relocations of one type targeting one
+    /// section. Their data is `count` ULEB128-encoded deltas between consecutive (sorted) offsets,
+    /// the first one being relative to the start of the section.
+    ///
+    /// Only the group directory is validated on construction; the offsets of a section are decoded
+    /// when its relocations are applied, so sections which are never touched cost nothing.
+    class RelocationTable
+    {
+    public:
+        /// Parses and validates the group directory; throws `LoaderError` if it is malformed
+        explicit RelocationTable(std::string_view section_data, ByteOrder order = ByteOrder::big);
+
+        bool has_relocations(uint32_t section_index) const;
+
+        /// Applies all relocations targeting the given section to its (writable) data
+        ///
+        /// Patched fields are encoded in the byte order of the table. Throws `LoaderError` if a
+        /// relocation falls outside the section or the offsets are malformed, in which case the
+        /// section is left untouched (the offsets are decoded twice: once to validate them all, once
+        /// to patch).
+        void apply(uint32_t section_index, char* section_bytes, uint64_t section_size, uint64_t displacement) const;
+
+    private:
+        struct Group
+        {
+            uint32_t section_index;
+            RelocationType type;
+            uint32_t count;
+            std::string_view data;
+        };
+
+        uint32_t lower_bound(uint32_t section_index) const;
+        Group group(uint32_t index) const;
+
+        ByteOrder order;
+        uint32_t group_count;
+        const char* groups;
+        std::string_view data;
+    };
+
+    /// Serializes a relocation section
+    std::string build_relocation_table(std::vector<Relocation> relocations, ByteOrder order = ByteOrder::big);
+
+    /// Rewrites a relocation section after the sections of its file were renumbered
+    ///
+    /// `new_indices[i]` is the new index of the section which had index `i`. Throws `LoaderError` if
+    /// the table is malformed or targets a section which is not in `new_indices`.
+    std::string remap_relocation_table(
+        std::string_view section_data,
+        const std::vector<uint32_t>& new_indices,
+        ByteOrder order = ByteOrder::big
+    );
+}
+
+
+} // namespace pex::loader
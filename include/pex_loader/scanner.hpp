@@ -0,0 +1,55 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+/// Options of `scan_file`
+struct ScanOptions
+{
+    /// Size of a single sequential read (rounded up to the page size)
+    size_t read_size = size_t(8) << 20;
+
+    /// Read with `O_DIRECT`, bypassing the page cache. If the file system does not support it, or
+    /// if this is false, the file is read through the page cache with `POSIX_FADV_NOREUSE`, and
+    /// the pages which were not cached before the read are dropped with `POSIX_FADV_DONTNEED`
+    /// right after they are processed (pages already cached, e.g. used by another process, stay)
+    bool direct_io = true;
+
+    /// Called with every piece of the file in order, e.g. to checksum it; `file_offset` is the
+    /// offset of `data` in the file
+    std::function<void(uint64_t file_offset, std::string_view data)> on_data;
+};
+
+
+/// Result of `scan_file`
+struct ScanResult
+{
+    EarlyHeaderInfo header;
+    /// Section table, with offsets relative to the part of the file after the early header (as
+    /// returned by `read_file_sections`)
+    std::vector<v0::Section> sections;
+    uint64_t file_size;
+    /// True if the file was actually read with `O_DIRECT`
+    bool direct_io;
+};
+
+
+/// Validates the early header and the section table of a file while reading it sequentially
+///
+/// Meant for sweeps over large stores: the file is read once, front to back, in large chunks,
+/// and the header and the section table are validated as the data streams by, so scanning does
+/// not evict the page cache of other processes. Footer section tables are read up front with a
+/// couple of positioned reads. Throws `LoaderError` if the file cannot be read or is malformed.
+ScanResult scan_file(const std::string& path, const ScanOptions& options = {});
+
+
+} // namespace pex::loader
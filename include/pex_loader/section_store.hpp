@@ -0,0 +1,56 @@
+#pragma once
+
+#include <pex_loader/mapped_file.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+/// Computes a fast, non-cryptographic 64-bit hash of section contents
+uint64_t content_hash(std::string_view data);
+
+
+/// SHA-256 digest of some contents
+using ContentDigest = std::array<uint8_t, 32>;
+
+/// Computes the SHA-256 digest of the contents, for keys which must not collide even when the
+/// contents come from an untrusted file
+ContentDigest content_digest(std::string_view data);
+
+
+/// Process-wide store of read-only section contents, deduplicated by content
+///
+/// The store only holds weak references: a buffer is freed when the last module using it is
+/// destroyed.
+class SectionStore
+{
+public:
+    SectionStore() = default;
+    SectionStore(const SectionStore&) = delete;
+    SectionStore& operator=(const SectionStore&) = delete;
+
+    /// Returns a read-only buffer with the given contents, shared with every other caller which
+    /// asked for the same contents while the buffer is alive
+    std::shared_ptr<const AnonymousBuffer> get(std::string_view contents);
+    std::shared_ptr<const AnonymousBuffer> get(std::string_view contents, uint64_t hash);
+
+    /// Number of distinct live buffers
+    size_t size() const;
+
+    static SectionStore& global();
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, std::vector<std::weak_ptr<const AnonymousBuffer>>> buffers;
+};
+
+
+} // namespace pex::loader
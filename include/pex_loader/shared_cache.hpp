@@ -0,0 +1,173 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+
+namespace pex::loader
+{
+
+/// Read-only contents held in a sealed `memfd`, which can be shared between processes
+///
+/// The seals guarantee that nobody can modify or resize the contents, so a receiving process can
+/// map them without copying or validating them again.
+class SealedBuffer
+{
+public:
+    /// Creates a sealed memfd with the given contents; throws `LoaderError` on failure
+    static std::shared_ptr<const SealedBuffer> create(const std::string& name, std::string_view contents);
+
+    /// Takes ownership of a memfd received from another process, checking that it is sealed
+    static std::shared_ptr<const SealedBuffer> adopt(int fd);
+
+    ~SealedBuffer();
+
+    SealedBuffer(const SealedBuffer&) = delete;
+    SealedBuffer& operator=(const SealedBuffer&) = delete;
+
+    std::string_view data() const
+    {
+        return std::string_view(ptr, length);
+    }
+
+    int fd() const
+    {
+        return file_descriptor;
+    }
+
+private:
+    SealedBuffer(int fd, size_t size);
+
+    int file_descriptor;
+    char* ptr;
+    size_t length;
+};
+
+
+/// Options of a `ModuleBroker`
+struct BrokerOptions
+{
+    /// Users allowed to publish modules besides the broker's own effective user
+    ///
+    /// Any local user able to connect to the socket may fetch modules.
+    std::vector<uid_t> allowed_uids;
+
+    /// Total size of the published modules above which the least recently used ones are evicted
+    /// (0 disables eviction)
+    ///
+    /// Evicting a module only drops the broker's reference; processes which fetched it keep
+    /// their mappings.
+    uint64_t max_bytes = uint64_t(1) << 30;
+
+    /// Number of connections served concurrently
+    size_t thread_count = 4;
+
+    /// Time a connection may take to send its request or to accept the reply
+    std::chrono::milliseconds timeout{1000};
+};
+
+
+/// Host-local broker publishing sealed module contents over a Unix socket
+///
+/// Processes publish a processed module (for example, its decompressed sections) under a key
+/// once; every other process receives the memfd from the broker and maps the same pages.
+class ModuleBroker
+{
+public:
+    /// Listens on `socket_path` (replacing a stale socket file) and serves requests on
+    /// background threads
+    explicit ModuleBroker(const std::string& socket_path, const BrokerOptions& options = {});
+
+    /// Stops serving and removes the socket file
+    ~ModuleBroker();
+
+    ModuleBroker(const ModuleBroker&) = delete;
+    ModuleBroker& operator=(const ModuleBroker&) = delete;
+
+    /// Number of published modules
+    size_t size() const;
+
+    /// Total size of the published modules
+    uint64_t bytes() const;
+
+private:
+    struct Module
+    {
+        std::shared_ptr<const SealedBuffer> buffer;
+        /// Position in `recency`
+        std::list<std::string>::iterator position;
+    };
+
+    void accept_connections();
+    void serve_connections();
+    void handle(int connection);
+    bool may_publish(int connection) const;
+    std::shared_ptr<const SealedBuffer> find(const std::string& key);
+    bool insert(const std::string& key, std::shared_ptr<const SealedBuffer> buffer);
+
+    std::string socket_path;
+    BrokerOptions options;
+    int listen_fd;
+
+    mutable std::mutex mutex;
+    std::map<std::string, Module> modules;
+    /// Keys of the published modules, most recently used first
+    std::list<std::string> recency;
+    uint64_t total_bytes = 0;
+
+    /// Accepted connections waiting for a worker
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    std::deque<int> pending;
+    bool stopping = false;
+
+    std::thread acceptor;
+    std::vector<std::thread> workers;
+};
+
+
+/// Client of a `ModuleBroker`
+class ModuleCacheClient
+{
+public:
+    /// `timeout` bounds how long a request may wait for the broker
+    explicit ModuleCacheClient(std::string socket_path, std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+    /// Returns the module published under `key`, or `nullptr` if there is none
+    std::shared_ptr<const SealedBuffer> fetch(const std::string& key) const;
+
+    /// Publishes the buffer under `key`; returns false if another one is already published, or if
+    /// the broker refuses it (see `BrokerOptions`)
+    bool publish(const std::string& key, const SealedBuffer& buffer) const;
+
+    /// Returns the published module, or materializes, seals and publishes it if there is none
+    ///
+    /// When several processes race to publish the same key, all of them end up using the
+    /// buffer which was published first.
+    std::shared_ptr<const SealedBuffer> get_or_create(
+        const std::string& key,
+        const std::function<std::string()>& materialize
+    ) const;
+
+private:
+    std::string socket_path;
+    std::chrono::milliseconds timeout;
+};
+
+
+} // namespace pex::loader
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+
+namespace pex::loader::v1
+{
+
+/// Writes a version 1 file body with a footer section table (see `footer_table`)
+///
+/// Sections are written to the stream as soon as they are produced, so only the table entries
+/// (20 bytes per section) are kept in memory. The early header, if any, must be written to the
+/// stream before the writer is created.
+class SectionStreamWriter
+{
+public:
+    /// Writes the feature flags; `footer_table` is implied
+    SectionStreamWriter(std::ostream& out, uint32_t feature_flags = 0);
+
+    /// Writes a whole section
+    void add_section(const std::array<char, 4>& name, std::string_view data);
+
+    /// Starts a section whose data is then written in pieces with `append`
+    void begin_section(const std::array<char, 4>& name);
+    void append(std::string_view data);
+    void end_section();
+
+    /// Writes the section table and the footer
+    void finish();
+
+private:
+    struct Entry
+    {
+        uint64_t offset;
+        uint64_t size;
+        std::array<char, 4> name;
+    };
+
+    void write(std::string_view data);
+
+    std::ostream& out;
+    uint32_t flags;
+    uint64_t offset;
+    bool in_section;
+    bool finished;
+    std::vector<Entry> entries;
+};
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <pex_loader/symbol_table.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+/// Process-wide table of interned strings
+///
+/// The interner copies each string into storage it owns when the string is first inserted, so the
+/// memory a string came from (usually a mapped string table section) may be unmapped afterwards.
+/// Interned views stay valid for the lifetime of the interner; strings are never removed.
+/// Callers pass precomputed `name_hash` values, so interning is a single probe of the table. The
+/// hash is recomputed only when a string is inserted, so that a wrong hash (e.g. read from a corrupt
+/// file) can neither hide an interned string nor create a second canonical copy of it.
+class StringInterner
+{
+public:
+    StringInterner() = default;
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    /// Returns the canonical view equal to `str`, inserting `str` if it is not interned yet; throws
+    /// `LoaderError` if `hash` is not `name_hash(str)`
+    std::string_view intern(std::string_view str, uint32_t hash);
+    std::string_view intern(std::string_view str);
+
+    /// Returns the canonical view equal to `str`, or nothing if it is not interned (or if `hash` is
+    /// not `name_hash(str)`)
+    std::optional<std::string_view> find(std::string_view str, uint32_t hash) const;
+    std::optional<std::string_view> find(std::string_view str) const;
+
+    size_t size() const;
+
+    static StringInterner& global();
+
+private:
+    struct Slot
+    {
+        uint32_t hash;
+        std::string_view str;
+        bool used;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::vector<Slot> slots;
+        size_t used_count = 0;
+        /// Copies of the inserted strings; new ones go into the last `block_free` bytes of the last block
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t block_free = 0;
+    };
+
+    static constexpr size_t shard_count = 16;
+    Shard& shard_for(uint32_t hash) const;
+    static void grow(Shard& shard);
+    static std::string_view store(Shard& shard, std::string_view str);
+
+    mutable std::array<Shard, shard_count> shards;
+};
+
+
+namespace v0
+{
+    /// Read-only view of a string table section
+    ///
+    /// Section layout (all integers are in the byte order of the file):
+    ///
+    ///     u32 string_count
+    ///     { u32 offset; u32 size; u32 hash; } entries[string_count]
+    ///     u8  data[]
+    ///
+    /// `hash` is `name_hash` of the string, precomputed by the writer. Strings are returned as views
+    /// into the section data, which must outlive the table and the views.
+    class StringTable
+    {
+    public:
+        /// Parses and validates the section; throws `LoaderError` if it is malformed
+        explicit StringTable(std::string_view section_data, ByteOrder order = ByteOrder::big);
+
+        uint32_t size() const
+        {
+            return string_count;
+        }
+
+        std::string_view operator[](uint32_t index) const;
+        uint32_t hash(uint32_t index) const;
+
+        /// Interns the string using its stored hash; throws `LoaderError` if the hash is wrong
+        ///
+        /// The returned view points into the interner, not into the section data.
+        std::string_view intern(uint32_t index, StringInterner& interner = StringInterner::global()) const;
+
+    private:
+        ByteOrder order;
+        uint32_t string_count;
+        const char* entries;
+        std::string_view data;
+    };
+
+    /// Serializes a string table section
+    std::string build_string_table(const std::vector<std::string_view>& strings, ByteOrder order = ByteOrder::big);
+}
+
+
+} // namespace pex::loader
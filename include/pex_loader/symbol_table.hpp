@@ -0,0 +1,94 @@
+#pragma once
+
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace pex::loader
+{
+
+/// Computes the hash of a symbol name (the same function as used by GNU-style ELF hash tables)
+constexpr uint32_t name_hash(std::string_view name)
+{
+    uint32_t hash = 5381;
+    for (char c : name) {
+        hash = hash * 33 + uint8_t(c);
+    }
+    return hash;
+}
+
+
+namespace v0
+{
+    /// Symbol found in a symbol table section
+    struct Symbol
+    {
+        std::string_view name;
+        uint64_t value;
+    };
+
+    /// Read-only view of a symbol table section
+    ///
+    /// Section layout (all integers are in the byte order of the file, see `MappedFile::byte_order`):
+    ///
+    ///     u32 symbol_count
+    ///     u32 bucket_count
+    ///     u32 bloom_word_count     (power of two)
+    ///     u32 bloom_shift
+    ///     u64 bloom[bloom_word_count]
+    ///     u32 buckets[bucket_count]   (index of the first symbol in the bucket, or 0xFFFFFFFF)
+    ///     u32 hashes[symbol_count]    (symbol hash; the lowest bit marks the end of a chain)
+    ///     { u32 name_offset; u32 name_size; u64 value; } entries[symbol_count]
+    ///     u8  names[]
+    ///
+    /// Symbols of the same bucket are stored contiguously. A negative lookup usually stops at the
+    /// bloom filter, so it only touches a single cache line of the section.
+    ///
+    /// The view does not own the section data, which must outlive it.
+    class SymbolTable
+    {
+    public:
+        /// Parses and validates the section; throws `LoaderError` if it is malformed
+        explicit SymbolTable(std::string_view section_data, ByteOrder order = ByteOrder::big);
+
+        std::optional<Symbol> lookup(std::string_view name) const;
+        std::optional<Symbol> lookup(std::string_view name, uint32_t hash) const;
+
+        /// Returns true if the bloom filter does not rule out the given hash
+        bool may_contain(uint32_t hash) const;
+
+        uint32_t size() const
+        {
+            return symbol_count;
+        }
+
+        Symbol operator[](uint32_t index) const;
+
+    private:
+        ByteOrder order;
+        uint32_t symbol_count;
+        uint32_t bucket_count;
+        uint32_t bloom_mask;
+        uint32_t bloom_shift;
+        const char* bloom;
+        const char* buckets;
+        const char* hashes;
+        const char* entries;
+        std::string_view names;
+    };
+
+    /// Serializes a symbol table section. Names must be unique
+    std::string build_symbol_table(
+        const std::vector<std::pair<std::string, uint64_t>>& symbols,
+        ByteOrder order = ByteOrder::big
+    );
+}
+
+
+} // namespace pex::loader
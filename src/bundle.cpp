@@ -0,0 +1,159 @@
+#include <pex_loader/bundle.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+constexpr std::string_view bundle_magic = "PEXB";
+constexpr uint32_t bundle_version = 0;
+constexpr uint64_t header_size = 16;
+constexpr uint64_t entry_size = 32;
+constexpr uint64_t image_alignment = 4096;
+
+
+bool in_bounds(uint64_t offset, uint64_t size, uint64_t total)
+{
+    return offset <= total && size <= total - offset;
+}
+
+}
+
+
+Bundle::Bundle(const std::string& path, bool huge_page_aligned):
+    mapping(std::make_shared<FileMapping>(path, huge_page_aligned))
+{
+    using detail::load_be;
+
+    auto data = mapping->data();
+    if (data.size() < header_size) {
+        throw LoaderError("Unexpected EOF while reading bundle header");
+    }
+    if (data.substr(0, 4) != bundle_magic) {
+        throw LoaderError("Invalid bundle magic signature");
+    }
+    auto version = load_be<uint32_t>(data.data() + 4);
+    if (version != bundle_version) {
+        throw LoaderError("Unsupported bundle version: " + std::to_string(version));
+    }
+
+    module_count = load_be<uint64_t>(data.data() + 8);
+    if (module_count > (data.size() - header_size) / entry_size) {
+        throw LoaderError("Unexpected EOF while reading bundle index");
+    }
+
+    // Validate the whole index once, so that lookups do not need to
+    for (uint64_t i = 0; i < module_count; ++i) {
+        const char* raw = data.data() + header_size + i * entry_size;
+        if (!in_bounds(load_be<uint64_t>(raw), load_be<uint64_t>(raw + 8), data.size())
+            || !in_bounds(load_be<uint64_t>(raw + 16), load_be<uint64_t>(raw + 24), data.size())) {
+            throw LoaderError("Bundle entry is out of the file bounds");
+        }
+        if (i > 0 && !(entry(i - 1).name < entry(i).name)) {
+            throw LoaderError("Bundle index is not sorted");
+        }
+    }
+}
+
+
+Bundle::Entry Bundle::entry(size_t index) const
+{
+    using detail::load_be;
+
+    auto data = mapping->data();
+    const char* raw = data.data() + header_size + index * entry_size;
+    return Entry{
+        data.substr(load_be<uint64_t>(raw), load_be<uint64_t>(raw + 8)),
+        data.substr(load_be<uint64_t>(raw + 16), load_be<uint64_t>(raw + 24)),
+    };
+}
+
+
+std::string_view Bundle::module_name(size_t index) const
+{
+    if (index >= module_count) {
+        throw LoaderError("Bundle module index out of range: " + std::to_string(index));
+    }
+    return entry(index).name;
+}
+
+
+std::optional<std::string_view> Bundle::find(std::string_view name) const
+{
+    uint64_t lo = 0;
+    uint64_t hi = module_count;
+    while (lo < hi) {
+        auto mid = lo + (hi - lo) / 2;
+        auto current = entry(mid);
+        if (current.name < name) {
+            lo = mid + 1;
+        } else if (name < current.name) {
+            hi = mid;
+        } else {
+            return current.image;
+        }
+    }
+    return std::nullopt;
+}
+
+
+std::shared_ptr<MappedFile> Bundle::load(std::string_view name, const LoadOptions& options) const
+{
+    auto image = find(name);
+    if (!image) {
+        throw LoaderError("Module '" + std::string(name) + "' is not found in bundle '" + mapping->path() + "'");
+    }
+    return std::make_shared<MappedFile>(mapping, *image, options);
+}
+
+
+std::string write_bundle(std::vector<std::pair<std::string_view, std::string_view>> modules)
+{
+    using detail::append_be;
+
+    std::sort(modules.begin(), modules.end());
+    for (size_t i = 1; i < modules.size(); ++i) {
+        if (modules[i - 1].first == modules[i].first) {
+            throw LoaderError("Duplicate module name in bundle: '" + std::string(modules[i].first) + "'");
+        }
+    }
+
+    uint64_t names_offset = header_size + modules.size() * entry_size;
+    uint64_t names_size = 0;
+    for (const auto& module : modules) {
+        names_size += module.first.size();
+    }
+
+    std::string out(bundle_magic);
+    append_be<uint32_t>(out, bundle_version);
+    append_be<uint64_t>(out, modules.size());
+
+    uint64_t name_offset = names_offset;
+    uint64_t image_offset = names_offset + names_size;
+    for (const auto& [name, image] : modules) {
+        image_offset = (image_offset + image_alignment - 1) / image_alignment * image_alignment;
+        append_be<uint64_t>(out, name_offset);
+        append_be<uint64_t>(out, name.size());
+        append_be<uint64_t>(out, image_offset);
+        append_be<uint64_t>(out, image.size());
+        name_offset += name.size();
+        image_offset += image.size();
+    }
+    for (const auto& module : modules) {
+        out += module.first;
+    }
+    for (const auto& module : modules) {
+        out.resize((out.size() + image_alignment - 1) / image_alignment * image_alignment, '\0');
+        out += module.second;
+    }
+    return out;
+}
+
+}
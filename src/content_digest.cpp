@@ -0,0 +1,107 @@
+#include <pex_loader/section_store.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+// SHA-256, see FIPS 180-4
+
+constexpr uint32_t round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+
+uint32_t rotate_right(uint32_t value, unsigned bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+
+void compress(uint32_t (&state)[8], const char* block)
+{
+    uint32_t w[64];
+    for (size_t i = 0; i < 16; ++i) {
+        w[i] = detail::load_be<uint32_t>(block + 4 * i);
+    }
+    for (size_t i = 16; i < 64; ++i) {
+        auto s0 = rotate_right(w[i - 15], 7) ^ rotate_right(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        auto s1 = rotate_right(w[i - 2], 17) ^ rotate_right(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (size_t i = 0; i < 64; ++i) {
+        auto s1 = rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25);
+        auto choice = (e & f) ^ (~e & g);
+        auto t1 = h + s1 + choice + round_constants[i] + w[i];
+        auto s0 = rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22);
+        auto majority = (a & b) ^ (a & c) ^ (b & c);
+        auto t2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+}
+
+
+ContentDigest content_digest(std::string_view data)
+{
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    size_t full_blocks = data.size() / 64;
+    for (size_t i = 0; i < full_blocks; ++i) {
+        compress(state, data.data() + 64 * i);
+    }
+
+    // Padding: a single 1 bit, zeros, and the message length in bits
+    char tail[128] = {};
+    size_t remaining = data.size() - 64 * full_blocks;
+    std::memcpy(tail, data.data() + 64 * full_blocks, remaining);
+    tail[remaining] = char(0x80);
+    size_t tail_size = remaining < 56 ? 64 : 128;
+    detail::store_be<uint64_t>(tail + tail_size - 8, uint64_t(data.size()) * 8);
+    for (size_t offset = 0; offset < tail_size; offset += 64) {
+        compress(state, tail + offset);
+    }
+
+    ContentDigest digest;
+    for (size_t i = 0; i < 8; ++i) {
+        detail::store_be<uint32_t>(reinterpret_cast<char*>(digest.data()) + 4 * i, state[i]);
+    }
+    return digest;
+}
+
+}
@@ -0,0 +1,61 @@
+#include <pex_loader/section_store.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+constexpr uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+
+
+uint64_t mix(uint64_t value)
+{
+    value ^= value >> 32;
+    value *= 0xD6E8FEB86659FD93ull;
+    value ^= value >> 32;
+    return value;
+}
+
+}
+
+
+uint64_t content_hash(std::string_view data)
+{
+    // Four independent lanes keep the multiplications pipelined on long inputs
+    uint64_t lanes[4] = {data.size(), multiplier, ~uint64_t(data.size()), 0x243F6A8885A308D3ull};
+    const char* ptr = data.data();
+    size_t remaining = data.size();
+
+    while (remaining >= 32) {
+        for (auto& lane : lanes) {
+            uint64_t word;
+            std::memcpy(&word, ptr, 8);
+            lane = (lane ^ word) * multiplier;
+            lane ^= lane >> 29;
+            ptr += 8;
+        }
+        remaining -= 32;
+    }
+
+    uint64_t hash = mix(lanes[0]) ^ mix(lanes[1] + 1) ^ mix(lanes[2] + 2) ^ mix(lanes[3] + 3);
+    while (remaining >= 8) {
+        uint64_t word;
+        std::memcpy(&word, ptr, 8);
+        hash = mix((hash ^ word) * multiplier);
+        ptr += 8;
+        remaining -= 8;
+    }
+    if (remaining > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, ptr, remaining);
+        hash = mix((hash ^ word ^ (uint64_t(remaining) << 56)) * multiplier);
+    }
+    return hash;
+}
+
+}
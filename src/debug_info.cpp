@@ -0,0 +1,62 @@
+#include <pex_loader/debug_info.hpp>
+
+#include <pex_loader/section_store.hpp>
+
+
+namespace pex::loader
+{
+
+DebugInfo::DebugInfo(const MappedFile& file):
+    file(file),
+    debug_link(file.find_section(v0::debug_link_section_name))
+{ }
+
+
+std::string_view DebugInfo::section_data(const std::array<char, 4>& name) const
+{
+    if (auto section = file.find_section(name)) {
+        return file.section_data(*section);
+    }
+    if (debug_link == nullptr) {
+        return {};
+    }
+    const auto& debug_file = companion();
+    if (auto section = debug_file.find_section(name)) {
+        return debug_file.section_data(*section);
+    }
+    return {};
+}
+
+
+std::string DebugInfo::companion_path() const
+{
+    if (debug_link == nullptr) {
+        return {};
+    }
+    auto link = v0::read_debug_link(file.section_data(*debug_link), file.byte_order());
+    std::string path(link.path);
+    if (!path.empty() && path.front() == '/') {
+        return path;
+    }
+    const auto& main_path = file.mapping().path();
+    auto slash = main_path.rfind('/');
+    return slash == std::string::npos ? path : main_path.substr(0, slash + 1) + path;
+}
+
+
+const MappedFile& DebugInfo::companion() const
+{
+    // If loading fails, the exception propagates and the next request tries again
+    std::call_once(companion_once, [this]() {
+        auto path = companion_path();
+        auto debug_file = std::make_unique<MappedFile>(path);
+        auto link = v0::read_debug_link(file.section_data(*debug_link), file.byte_order());
+        if (content_hash(debug_file->data().substr(early_header_size)) != link.checksum) {
+            throw LoaderError("Debug file '" + path + "' does not match the module");
+        }
+        companion_file = std::move(debug_file);
+    });
+    return *companion_file;
+}
+
+}
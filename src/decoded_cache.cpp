@@ -0,0 +1,348 @@
+#include <pex_loader/decoded_cache.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+#include <pex_loader/section_store.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+constexpr std::string_view sidecar_magic = "PEXC";
+constexpr uint64_t sidecar_header_size = 56;
+constexpr uint64_t sidecar_entry_size = 72;
+constexpr uint64_t sidecar_alignment = 16;
+
+
+/// Identifies the image a sidecar was written for, without reading its contents
+struct FileIdentity
+{
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t modification_time;
+    uint64_t image_offset;
+
+    bool operator==(const FileIdentity& other) const
+    {
+        return device == other.device && inode == other.inode && size == other.size
+            && modification_time == other.modification_time && image_offset == other.image_offset;
+    }
+};
+
+
+struct SidecarEntry
+{
+    uint64_t section_index;
+    uint64_t section_offset;
+    uint64_t source_size;
+    ContentDigest digest;
+    std::string_view decoded;
+};
+
+
+struct Sidecar
+{
+    FileIdentity identity;
+    std::vector<SidecarEntry> entries;
+};
+
+
+FileIdentity file_identity(const MappedFile& file)
+{
+    struct stat st;
+    if (fstat(file.mapping().fd(), &st) != 0) {
+        throw LoaderError("Unable to stat '" + file.mapping().path() + "': " + std::strerror(errno));
+    }
+    return FileIdentity{
+        uint64_t(st.st_dev),
+        uint64_t(st.st_ino),
+        uint64_t(st.st_size),
+        uint64_t(st.st_mtim.tv_sec) * 1000000000 + uint64_t(st.st_mtim.tv_nsec),
+        uint64_t(file.data().data() - file.mapping().data().data()),
+    };
+}
+
+
+/// Parses a sidecar; returns nothing if it is stale or malformed
+std::optional<Sidecar> read_sidecar(std::string_view data, uint32_t decoder_version)
+{
+    using detail::load_be;
+
+    if (data.size() < sidecar_header_size || data.substr(0, 4) != sidecar_magic) {
+        return std::nullopt;
+    }
+    if (load_be<uint32_t>(data.data() + 4) != decoder_version) {
+        return std::nullopt;
+    }
+    auto count = load_be<uint64_t>(data.data() + 48);
+    if (count > (data.size() - sidecar_header_size) / sidecar_entry_size) {
+        return std::nullopt;
+    }
+
+    Sidecar sidecar;
+    sidecar.identity = FileIdentity{
+        load_be<uint64_t>(data.data() + 8),
+        load_be<uint64_t>(data.data() + 16),
+        load_be<uint64_t>(data.data() + 24),
+        load_be<uint64_t>(data.data() + 32),
+        load_be<uint64_t>(data.data() + 40),
+    };
+    sidecar.entries.reserve(size_t(count));
+    for (uint64_t i = 0; i < count; ++i) {
+        const char* entry = data.data() + sidecar_header_size + i * sidecar_entry_size;
+        auto offset = load_be<uint64_t>(entry + 56);
+        auto size = load_be<uint64_t>(entry + 64);
+        if (offset > data.size() || size > data.size() - offset) {
+            return std::nullopt;
+        }
+        SidecarEntry parsed;
+        parsed.section_index = load_be<uint64_t>(entry);
+        parsed.section_offset = load_be<uint64_t>(entry + 8);
+        parsed.source_size = load_be<uint64_t>(entry + 16);
+        std::memcpy(parsed.digest.data(), entry + 24, parsed.digest.size());
+        parsed.decoded = data.substr(offset, size);
+        sidecar.entries.push_back(parsed);
+    }
+    return sidecar;
+}
+
+
+std::string write_sidecar(const Sidecar& sidecar, uint32_t decoder_version)
+{
+    using detail::append_be;
+
+    std::string out(sidecar_magic);
+    append_be<uint32_t>(out, decoder_version);
+    append_be<uint64_t>(out, sidecar.identity.device);
+    append_be<uint64_t>(out, sidecar.identity.inode);
+    append_be<uint64_t>(out, sidecar.identity.size);
+    append_be<uint64_t>(out, sidecar.identity.modification_time);
+    append_be<uint64_t>(out, sidecar.identity.image_offset);
+    append_be<uint64_t>(out, sidecar.entries.size());
+
+    // Sections with the same contents share their decoded data
+    std::map<const char*, uint64_t> data_offsets;
+    std::vector<std::string_view> blobs;
+    uint64_t offset = sidecar_header_size + sidecar.entries.size() * sidecar_entry_size;
+    for (const auto& entry : sidecar.entries) {
+        auto [it, inserted] = data_offsets.emplace(entry.decoded.data(), 0);
+        if (inserted) {
+            offset = (offset + sidecar_alignment - 1) & ~(sidecar_alignment - 1);
+            it->second = offset;
+            offset += entry.decoded.size();
+            blobs.push_back(entry.decoded);
+        }
+        append_be<uint64_t>(out, entry.section_index);
+        append_be<uint64_t>(out, entry.section_offset);
+        append_be<uint64_t>(out, entry.source_size);
+        out.append(reinterpret_cast<const char*>(entry.digest.data()), entry.digest.size());
+        append_be<uint64_t>(out, it->second);
+        append_be<uint64_t>(out, entry.decoded.size());
+    }
+    for (auto blob : blobs) {
+        out.resize((out.size() + sidecar_alignment - 1) & ~(sidecar_alignment - 1), '\0');
+        out += blob;
+    }
+    return out;
+}
+
+
+/// Atomically replaces the file at `path`; returns false if it cannot be written
+bool replace_file(const std::string& path, std::string_view contents)
+{
+    auto temp_path = path + ".XXXXXX";
+    int fd = mkostemp(temp_path.data(), O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    const char* data = contents.data();
+    size_t remaining = contents.size();
+    while (remaining > 0) {
+        auto written = write(fd, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        data += written;
+        remaining -= size_t(written);
+    }
+    bool ok = remaining == 0 && fchmod(fd, 0644) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+std::shared_ptr<const FileMapping> try_map(const std::string& path)
+{
+    try {
+        return std::make_shared<FileMapping>(path);
+    } catch (const LoaderError&) {
+        return nullptr;
+    }
+}
+
+}
+
+
+DecodedSections::DecodedSections(
+    const MappedFile& file,
+    const SectionDecoder& decoder,
+    const std::string& sidecar_path
+):
+    file(file),
+    views(file.sections().size()),
+    decode_count(0)
+{
+    auto path = sidecar_path.empty() ? default_sidecar_path(file) : sidecar_path;
+    const auto& sections = file.sections();
+    auto identity = file_identity(file);
+
+    std::vector<size_t> code_sections;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        if (sections[i].name == decoder.section_name) {
+            code_sections.push_back(i);
+        }
+    }
+
+    // Digests are only needed when the file changed since the sidecar was written, and are
+    // computed at most once per section
+    std::vector<std::optional<ContentDigest>> digests(sections.size());
+    auto digest_of = [&](size_t index) -> const ContentDigest& {
+        if (!digests[index]) {
+            digests[index] = content_digest(file.section_data(sections[index]));
+        }
+        return *digests[index];
+    };
+
+    // Fills `views` from the sidecar; returns true if every code section was found
+    auto resolve = [&](const Sidecar& cache) {
+        if (cache.identity == identity) {
+            // Same file: entries are matched by index, and their location checked
+            for (const auto& entry : cache.entries) {
+                if (entry.section_index >= sections.size()) {
+                    continue;
+                }
+                const auto& section = sections[entry.section_index];
+                if (
+                    section.name == decoder.section_name
+                    && section.offset == entry.section_offset
+                    && section.size == entry.source_size
+                ) {
+                    views[entry.section_index] = entry.decoded;
+                }
+            }
+        } else {
+            // Rebuilt file: the sections which did not change are found by contents
+            std::map<std::pair<ContentDigest, uint64_t>, std::string_view> by_contents;
+            for (const auto& entry : cache.entries) {
+                by_contents.emplace(std::make_pair(entry.digest, entry.source_size), entry.decoded);
+            }
+            for (auto i : code_sections) {
+                auto it = by_contents.find({digest_of(i), sections[i].size});
+                if (it != by_contents.end()) {
+                    views[i] = it->second;
+                }
+            }
+        }
+        return std::all_of(code_sections.begin(), code_sections.end(), [this](size_t i) {
+            return views[i].data() != nullptr;
+        });
+    };
+
+    sidecar = try_map(path);
+    std::optional<Sidecar> cached;
+    if (sidecar != nullptr) {
+        cached = read_sidecar(sidecar->data(), decoder.version);
+    }
+    if (cached && resolve(*cached)) {
+        return;
+    }
+
+    // Sections with the same contents are decoded once. `owned` never reallocates, so the views
+    // into it stay valid
+    std::map<std::pair<ContentDigest, uint64_t>, size_t> decoded_index;
+    owned.reserve(code_sections.size());
+    for (auto i : code_sections) {
+        if (views[i].data() != nullptr) {
+            continue;
+        }
+        auto [it, inserted] = decoded_index.emplace(std::make_pair(digest_of(i), sections[i].size), owned.size());
+        if (inserted) {
+            owned.push_back(decoder.decode(file.section_data(sections[i])));
+            ++decode_count;
+        }
+        views[i] = owned[it->second];
+    }
+
+    Sidecar updated{identity, {}};
+    for (auto i : code_sections) {
+        updated.entries.push_back(SidecarEntry{i, sections[i].offset, sections[i].size, digest_of(i), views[i]});
+    }
+
+    std::shared_ptr<const FileMapping> written;
+    if (replace_file(path, write_sidecar(updated, decoder.version))) {
+        written = try_map(path);
+    }
+    std::optional<Sidecar> reread;
+    if (written != nullptr) {
+        reread = read_sidecar(written->data(), decoder.version);
+    }
+
+    // Another loader may have replaced the sidecar in the meantime, in which case the decoded
+    // sections are kept in memory
+    auto in_memory = views;
+    std::fill(views.begin(), views.end(), std::string_view());
+    if (reread && resolve(*reread)) {
+        sidecar = std::move(written);
+        owned.clear();
+        owned.shrink_to_fit();
+    } else {
+        views = std::move(in_memory);
+    }
+}
+
+
+std::string_view DecodedSections::decoded(const v0::Section& section) const
+{
+    auto view = views[file.index_of(section)];
+    if (view.data() == nullptr) {
+        throw LoaderError("Section was not decoded");
+    }
+    return view;
+}
+
+
+std::string DecodedSections::default_sidecar_path(const MappedFile& file)
+{
+    auto image_offset = uint64_t(file.data().data() - file.mapping().data().data());
+    if (image_offset == 0) {
+        return file.mapping().path() + ".decoded";
+    }
+    return file.mapping().path() + "." + std::to_string(image_offset) + ".decoded";
+}
+
+}
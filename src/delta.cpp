@@ -0,0 +1,373 @@
+#include <pex_loader/delta.hpp>
+
+#include <libbinary_format/data_reader.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/section_store.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+constexpr std::string_view delta_magic = "PEXD";
+constexpr uint32_t delta_version = 2;
+constexpr uint8_t copy_op = 0;
+constexpr uint8_t insert_op = 1;
+
+/// Size of the section header (encoded size and name) in front of the section data
+constexpr uint64_t section_header_size = 12;
+
+
+class DeltaWriter
+{
+public:
+    void copy(uint64_t old_offset, uint64_t size)
+    {
+        if (size == 0) {
+            return;
+        }
+        bool extends_last = !ops.empty() && ops.back().kind == copy_op
+            && ops.back().old_offset + ops.back().size == old_offset;
+        if (extends_last) {
+            ops.back().size += size;
+            return;
+        }
+        ops.push_back(Op{copy_op, old_offset, size, {}});
+    }
+
+    void insert(std::string_view data)
+    {
+        if (data.empty()) {
+            return;
+        }
+        if (!ops.empty() && ops.back().kind == insert_op) {
+            ops.back().size += data.size();
+            ops.back().data += data;
+            return;
+        }
+        ops.push_back(Op{insert_op, 0, data.size(), std::string(data)});
+    }
+
+    /// Serializes the delta; copies record the hash of their range of `old_data`
+    std::string finish(std::string_view old_data, uint64_t new_size) const
+    {
+        using detail::append_be;
+
+        std::string out(delta_magic);
+        append_be<uint32_t>(out, delta_version);
+        append_be<uint64_t>(out, old_data.size());
+        append_be<uint64_t>(out, new_size);
+        append_be<uint64_t>(out, ops.size());
+        for (const auto& op : ops) {
+            out.push_back(char(op.kind));
+            if (op.kind == copy_op) {
+                append_be<uint64_t>(out, op.old_offset);
+                append_be<uint64_t>(out, op.size);
+                append_be<uint64_t>(out, content_hash(old_data.substr(op.old_offset, op.size)));
+            } else {
+                append_be<uint64_t>(out, op.size);
+                out += op.data;
+            }
+        }
+        return out;
+    }
+
+private:
+    struct Op
+    {
+        uint8_t kind;
+        uint64_t old_offset;
+        uint64_t size;
+        std::string data;
+    };
+
+    std::vector<Op> ops;
+};
+
+
+std::vector<v0::Section> read_v0_sections(std::string_view data)
+{
+    auto header = read_early_header(data);
+    if (header.format_version.major != 0) {
+        throw LoaderError("Deltas only support format major version 0");
+    }
+    return v0::read_sections(data.substr(early_header_size));
+}
+
+
+std::string system_error_message(const std::string& what, const std::string& path)
+{
+    return what + " '" + path + "': " + std::strerror(errno);
+}
+
+
+/// Closes the file descriptor when going out of scope
+struct FileDescriptor
+{
+    ~FileDescriptor()
+    {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    int fd;
+};
+
+
+/// File created next to its final path and renamed over it once complete
+///
+/// The file is removed if it is destroyed before being committed.
+class TemporaryFile
+{
+public:
+    explicit TemporaryFile(const std::string& final_path):
+        final_path(final_path),
+        path(final_path + ".XXXXXX"),
+        file_descriptor(mkostemp(path.data(), O_CLOEXEC))
+    {
+        if (file_descriptor < 0) {
+            throw LoaderError(system_error_message("Unable to create a temporary file for", final_path));
+        }
+    }
+
+    ~TemporaryFile()
+    {
+        if (file_descriptor >= 0) {
+            close(file_descriptor);
+        }
+        if (!committed) {
+            unlink(path.c_str());
+        }
+    }
+
+    TemporaryFile(const TemporaryFile&) = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    int fd() const
+    {
+        return file_descriptor;
+    }
+
+    /// Syncs the contents and atomically replaces the final path
+    void commit()
+    {
+        if (fchmod(file_descriptor, 0644) != 0 || fsync(file_descriptor) != 0) {
+            throw LoaderError(system_error_message("Unable to sync", path));
+        }
+        int fd = file_descriptor;
+        file_descriptor = -1;
+        if (close(fd) != 0) {
+            throw LoaderError(system_error_message("Unable to write", path));
+        }
+        if (std::rename(path.c_str(), final_path.c_str()) != 0) {
+            throw LoaderError(system_error_message("Unable to rename a temporary file to", final_path));
+        }
+        committed = true;
+
+        // Makes the rename itself durable
+        auto slash = final_path.rfind('/');
+        auto directory = slash == std::string::npos ? "." : final_path.substr(0, slash + 1);
+        FileDescriptor directory_fd{open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+        if (directory_fd.fd >= 0) {
+            fsync(directory_fd.fd);
+        }
+    }
+
+private:
+    std::string final_path;
+    std::string path;
+    int file_descriptor;
+    bool committed = false;
+};
+
+
+void write_all(int fd, const char* data, uint64_t size, off_t offset, const std::string& path)
+{
+    while (size > 0) {
+        auto written = pwrite(fd, data, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw LoaderError(system_error_message("Unable to write", path));
+        }
+        data += written;
+        size -= uint64_t(written);
+        offset += written;
+    }
+}
+
+
+void copy_range(int in_fd, off_t in_offset, int out_fd, off_t out_offset, uint64_t size, const std::string& path)
+{
+    // Try the in-kernel copy first, and fall back to a buffered copy if the kernel or the file
+    // systems do not support it
+    while (size > 0) {
+        auto copied = copy_file_range(in_fd, &in_offset, out_fd, &out_offset, size, 0);
+        if (copied > 0) {
+            size -= uint64_t(copied);
+            continue;
+        }
+        if (copied == 0) {
+            throw LoaderError("Unexpected EOF while copying from '" + path + "'");
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP) {
+            throw LoaderError(system_error_message("Unable to copy from", path));
+        }
+        break;
+    }
+
+    std::vector<char> buffer(1 << 20);
+    while (size > 0) {
+        auto chunk = std::min<uint64_t>(size, buffer.size());
+        auto bytes = pread(in_fd, buffer.data(), chunk, in_offset);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            throw LoaderError(system_error_message("Unable to read", path));
+        }
+        write_all(out_fd, buffer.data(), uint64_t(bytes), out_offset, path);
+        in_offset += bytes;
+        out_offset += bytes;
+        size -= uint64_t(bytes);
+    }
+}
+
+}
+
+
+std::string make_delta(std::string_view old_data, std::string_view new_data)
+{
+    auto old_sections = read_v0_sections(old_data);
+    auto new_sections = read_v0_sections(new_data);
+
+    // Old sections by name and size; the contents are compared on lookup
+    std::multimap<std::tuple<std::array<char, 4>, uint64_t>, const v0::Section*> old_by_key;
+    for (const auto& section : old_sections) {
+        old_by_key.emplace(std::make_tuple(section.name, section.size), &section);
+    }
+
+    auto new_body = new_data.substr(early_header_size);
+    auto old_body = old_data.substr(early_header_size);
+
+    DeltaWriter writer;
+    // Early header and section count
+    writer.insert(new_data.substr(0, early_header_size + 8));
+
+    for (const auto& section : new_sections) {
+        auto contents = new_body.substr(section.offset, section.size);
+        auto range = old_by_key.equal_range(std::make_tuple(section.name, section.size));
+
+        const v0::Section* match = nullptr;
+        for (auto it = range.first; it != range.second; ++it) {
+            if (old_body.substr(it->second->offset, it->second->size) == contents) {
+                match = it->second;
+                break;
+            }
+        }
+
+        auto header_offset = section.offset - section_header_size;
+        if (match != nullptr) {
+            // The header is equal too, since both name and size are
+            writer.copy(
+                early_header_size + match->offset - section_header_size,
+                section.size + section_header_size
+            );
+        } else {
+            writer.insert(new_body.substr(header_offset, section.size + section_header_size));
+        }
+    }
+
+    // Anything after the last section
+    auto tail_offset = new_sections.empty() ? 8 : new_sections.back().offset + new_sections.back().size;
+    writer.insert(new_body.substr(tail_offset));
+
+    return writer.finish(old_data, new_data.size());
+}
+
+
+void apply_delta(const std::string& old_path, std::string_view delta, const std::string& new_path)
+{
+    libbinary_format::DataReader r(delta);
+    std::array<char, 4> magic;
+    r.read_bytes(4, magic.begin());
+    if (std::string_view(magic.data(), magic.size()) != delta_magic) {
+        throw LoaderError("Invalid delta magic signature");
+    }
+    auto version = r.read_uint<uint32_t>();
+    if (version != delta_version) {
+        throw LoaderError("Unsupported delta version: " + std::to_string(version));
+    }
+    auto old_size = r.read_uint<uint64_t>();
+    auto new_size = r.read_uint<uint64_t>();
+    auto op_count = r.read_uint<uint64_t>();
+
+    FileMapping old_file(old_path);
+    if (old_file.data().size() != old_size) {
+        throw LoaderError("Delta does not match '" + old_path + "': unexpected file size");
+    }
+
+    TemporaryFile new_file(new_path);
+    uint64_t out_offset = 0;
+    for (uint64_t i = 0; i < op_count; ++i) {
+        auto kind = r.read_uint<uint8_t>();
+        if (kind == copy_op) {
+            auto old_offset = r.read_uint<uint64_t>();
+            auto size = r.read_uint<uint64_t>();
+            auto hash = r.read_uint<uint64_t>();
+            if (old_offset > old_size || size > old_size - old_offset) {
+                throw LoaderError("Delta copy is out of the old file bounds");
+            }
+            if (size > new_size - out_offset) {
+                throw LoaderError("Delta produces a file larger than announced");
+            }
+            // Only the copied ranges end up in the result, so they are all that needs checking
+            if (content_hash(old_file.data().substr(old_offset, size)) != hash) {
+                throw LoaderError("Delta does not match '" + old_path + "': unexpected contents");
+            }
+            copy_range(old_file.fd(), off_t(old_offset), new_file.fd(), off_t(out_offset), size, old_path);
+            out_offset += size;
+        } else if (kind == insert_op) {
+            auto size = r.read_uint<uint64_t>();
+            if (size > new_size - out_offset) {
+                throw LoaderError("Delta produces a file larger than announced");
+            }
+            auto offset = r.get_offset();
+            r.skip(size);
+            write_all(new_file.fd(), delta.data() + offset, size, off_t(out_offset), new_path);
+            out_offset += size;
+        } else {
+            throw LoaderError("Invalid delta operation: " + std::to_string(static_cast<unsigned int>(kind)));
+        }
+    }
+
+    if (out_offset != new_size) {
+        throw LoaderError("Delta produced a file of unexpected size");
+    }
+    new_file.commit();
+}
+
+}
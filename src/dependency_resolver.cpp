@@ -0,0 +1,126 @@
+#include <pex_loader/dependencies.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+
+
+namespace pex::loader
+{
+
+DependencyResolver::DependencyResolver(Locator locator, const LoadOptions& options, size_t thread_count):
+    locator(std::move(locator)),
+    options(options),
+    thread_count(thread_count != 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency()))
+{ }
+
+
+LoadedModule DependencyResolver::load(const std::string& name, const std::string& path) const
+{
+    LoadedModule module;
+    module.name = name;
+    module.file = std::make_shared<MappedFile>(path, options);
+
+    for (const auto& section : module.file->sections()) {
+        if (section.name != v0::import_section_name) {
+            continue;
+        }
+        for (auto import : v0::read_imports(module.file->section_data(section), module.file->byte_order())) {
+            module.imports.emplace_back(import);
+        }
+    }
+    return module;
+}
+
+
+std::map<std::string, LoadedModule> DependencyResolver::resolve(
+    const std::string& root_name,
+    const std::string& path
+) const
+{
+    // A library is queued as soon as the first module importing it is loaded, and the workers
+    // take libraries off the queue until it is empty and no load that could extend it is running
+    struct Task
+    {
+        std::string name;
+        std::optional<std::string> path;
+    };
+
+    std::map<std::string, LoadedModule> modules;
+    std::set<std::string> seen{root_name};
+    std::deque<Task> pending{{root_name, path}};
+    size_t running = 0;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [&]() {
+                return error || !pending.empty() || running == 0;
+            });
+            if (error || pending.empty()) {
+                return;
+            }
+            auto task = std::move(pending.front());
+            pending.pop_front();
+            ++running;
+            lock.unlock();
+
+            // The first error is rethrown once all workers have stopped
+            LoadedModule module;
+            try {
+                module = load(task.name, task.path ? *task.path : locator(task.name));
+            } catch (...) {
+                lock.lock();
+                --running;
+                if (!error) {
+                    error = std::current_exception();
+                }
+                changed.notify_all();
+                return;
+            }
+
+            lock.lock();
+            --running;
+            for (const auto& import : module.imports) {
+                if (seen.insert(import).second) {
+                    pending.push_back({import, std::nullopt});
+                }
+            }
+            modules.emplace(task.name, std::move(module));
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count - 1);
+    try {
+        for (size_t i = 1; i < thread_count; ++i) {
+            workers.emplace_back(worker);
+        }
+        worker();
+    } catch (...) {
+        // Thread creation failed: stop the workers already started
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+        changed.notify_all();
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return modules;
+}
+
+}
@@ -0,0 +1,735 @@
+#include <pex_loader/mapped_file.hpp>
+
+#include <pex_loader/format.hpp>
+#include <pex_loader/section_store.hpp>
+#include <pex_loader/shared_cache.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+std::string system_error_message(const std::string& what, const std::string& path)
+{
+    return what + " '" + path + "': " + std::strerror(errno);
+}
+
+
+int advice_flag(AccessAdvice advice)
+{
+    switch (advice) {
+        case AccessAdvice::normal: {
+            return MADV_NORMAL;
+        }
+        case AccessAdvice::will_need: {
+            return MADV_WILLNEED;
+        }
+        case AccessAdvice::dont_need: {
+            return MADV_DONTNEED;
+        }
+        case AccessAdvice::sequential: {
+            return MADV_SEQUENTIAL;
+        }
+        case AccessAdvice::random: {
+            return MADV_RANDOM;
+        }
+    }
+    throw LoaderError("Invalid access advice");
+}
+
+
+uintptr_t align_down(uintptr_t value, uintptr_t alignment)
+{
+    return value & ~(alignment - 1);
+}
+
+
+uintptr_t align_up(uintptr_t value, uintptr_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+
+/// Returns the page-aligned range spanning `size` bytes at `begin`
+std::pair<uintptr_t, uintptr_t> page_range(const char* begin, size_t size)
+{
+    auto page_size = uintptr_t(sysconf(_SC_PAGESIZE));
+    auto first = align_down(reinterpret_cast<uintptr_t>(begin), page_size);
+    auto last = align_up(reinterpret_cast<uintptr_t>(begin) + size, page_size);
+    return {first, last};
+}
+
+
+void advise_range(const char* begin, size_t size, AccessAdvice advice)
+{
+    if (size == 0) {
+        return;
+    }
+    auto [first, last] = page_range(begin, size);
+    if (madvise(reinterpret_cast<void*>(first), last - first, advice_flag(advice)) != 0) {
+        throw LoaderError(std::string("madvise failed: ") + std::strerror(errno));
+    }
+}
+
+
+/// Counts the resident bytes of the pages spanning `size` bytes at `begin`
+uint64_t resident_bytes(const char* begin, size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+    auto page_size = uintptr_t(sysconf(_SC_PAGESIZE));
+    auto [first, last] = page_range(begin, size);
+    std::vector<unsigned char> pages((last - first) / page_size);
+    if (mincore(reinterpret_cast<void*>(first), last - first, pages.data()) != 0) {
+        throw LoaderError(std::string("mincore failed: ") + std::strerror(errno));
+    }
+
+    uint64_t resident = 0;
+    for (auto page : pages) {
+        resident += (page & 1) ? page_size : 0;
+    }
+    return resident;
+}
+
+
+/// Reserves `size` bytes (rounded up to the page size) of address space aligned to `alignment`
+///
+/// The reservation is inaccessible until something is mapped over it with `MAP_FIXED`.
+char* reserve_aligned(size_t size, size_t alignment)
+{
+    // The padding is trimmed with `munmap`, which only takes page-aligned ranges
+    size = align_up(size, size_t(sysconf(_SC_PAGESIZE)));
+    auto padded = size + alignment;
+    void* reserved = mmap(nullptr, padded, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        throw LoaderError(std::string("Unable to reserve address space: ") + std::strerror(errno));
+    }
+    auto begin = reinterpret_cast<uintptr_t>(reserved);
+    auto aligned = align_up(begin, alignment);
+    auto tail = aligned + size;
+    bool trimmed = aligned == begin || munmap(reserved, aligned - begin) == 0;
+    trimmed = trimmed && (tail == begin + padded || munmap(reinterpret_cast<void*>(tail), begin + padded - tail) == 0);
+    if (!trimmed) {
+        auto message = std::string("Unable to trim an address space reservation: ") + std::strerror(errno);
+        munmap(reserved, padded);
+        throw LoaderError(message);
+    }
+    return reinterpret_cast<char*>(aligned);
+}
+
+
+bool advise_huge_pages(const char* begin, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+    return size != 0 && madvise(const_cast<char*>(begin), size, MADV_HUGEPAGE) == 0;
+#else
+    (void)begin;
+    (void)size;
+    return false;
+#endif
+}
+
+
+/// Returns the size in bytes of the memory mapped with huge pages in the mapping containing `address`
+uint64_t smaps_huge_page_bytes(const char* address)
+{
+    std::ifstream smaps("/proc/self/smaps");
+    if (!smaps) {
+        return 0;
+    }
+    auto target = reinterpret_cast<uintptr_t>(address);
+
+    bool inside = false;
+    uint64_t total = 0;
+    std::string line;
+    while (std::getline(smaps, line)) {
+        auto dash = line.find('-');
+        auto space = line.find(' ');
+        bool is_range = dash != std::string::npos && space != std::string::npos && dash < space
+            && std::all_of(line.begin(), line.begin() + space, [](char c) {
+                return std::isxdigit(static_cast<unsigned char>(c)) || c == '-';
+            });
+        if (is_range) {
+            if (inside) {
+                break;
+            }
+            auto first = std::stoull(line.substr(0, dash), nullptr, 16);
+            auto last = std::stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16);
+            inside = first <= target && target < last;
+            continue;
+        }
+        if (!inside) {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        std::string key;
+        uint64_t kilobytes = 0;
+        fields >> key >> kilobytes;
+        if (key == "AnonHugePages:" || key == "FilePmdMapped:" || key == "ShmemPmdMapped:") {
+            total += kilobytes * 1024;
+        }
+    }
+    return total;
+}
+
+
+int open_file(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw LoaderError(system_error_message("Unable to open", path));
+    }
+    return fd;
+}
+
+
+/// Read-only mapping of a buffer shared between processes, placed at a huge page boundary
+class HugePageSharedMapping
+{
+public:
+    explicit HugePageSharedMapping(const SealedBuffer& buffer):
+        mapped_length(align_up(buffer.data().size(), size_t(sysconf(_SC_PAGESIZE))))
+    {
+        auto placement = reserve_aligned(mapped_length, huge_page_size);
+        void* mapped = mmap(placement, mapped_length, PROT_READ, MAP_SHARED | MAP_FIXED, buffer.fd(), 0);
+        if (mapped == MAP_FAILED) {
+            auto message = std::string("Unable to map a shared section copy: ") + std::strerror(errno);
+            munmap(placement, mapped_length);
+            throw LoaderError(message);
+        }
+        ptr = static_cast<char*>(mapped);
+        advise_huge_pages(ptr, mapped_length);
+    }
+
+    ~HugePageSharedMapping()
+    {
+        munmap(ptr, mapped_length);
+    }
+
+    HugePageSharedMapping(const HugePageSharedMapping&) = delete;
+    HugePageSharedMapping& operator=(const HugePageSharedMapping&) = delete;
+
+    const char* data() const
+    {
+        return ptr;
+    }
+
+    size_t capacity() const
+    {
+        return mapped_length;
+    }
+
+private:
+    char* ptr;
+    size_t mapped_length;
+};
+
+}
+
+
+FileMapping::FileMapping(const std::string& path, bool huge_page_aligned):
+    FileMapping(path, open_file(path), huge_page_aligned)
+{ }
+
+
+FileMapping::FileMapping(const std::string& path, int fd, bool huge_page_aligned):
+    file_path(path),
+    file_descriptor(fd),
+    ptr(nullptr),
+    length(0)
+{
+    struct stat st;
+    if (fstat(file_descriptor, &st) != 0) {
+        auto message = system_error_message("Unable to stat", path);
+        close(file_descriptor);
+        throw LoaderError(message);
+    }
+    length = size_t(st.st_size);
+    if (length == 0) {
+        return;
+    }
+
+    // Large files are placed at a huge page boundary, so that file offsets aligned to
+    // `huge_page_size` are aligned in memory as well
+    void* mapped;
+    if (huge_page_aligned && length >= huge_page_size) {
+        auto placement = reserve_aligned(length, huge_page_size);
+        mapped = mmap(placement, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, file_descriptor, 0);
+        if (mapped == MAP_FAILED) {
+            munmap(placement, length);
+        }
+    } else {
+        mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    }
+    if (mapped == MAP_FAILED) {
+        auto message = system_error_message("Unable to map", path);
+        close(file_descriptor);
+        throw LoaderError(message);
+    }
+    ptr = static_cast<char*>(mapped);
+}
+
+
+FileMapping::~FileMapping()
+{
+    if (ptr != nullptr) {
+        munmap(ptr, length);
+    }
+    close(file_descriptor);
+}
+
+
+AnonymousBuffer::AnonymousBuffer(size_t size, size_t alignment):
+    ptr(nullptr),
+    length(size),
+    mapped_length(align_up(std::max<size_t>(size, 1), alignment))
+{
+    ptr = reserve_aligned(mapped_length, alignment);
+    void* mapped = mmap(
+        ptr,
+        mapped_length,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+        -1,
+        0
+    );
+    if (mapped == MAP_FAILED) {
+        auto message = std::string("Unable to allocate anonymous memory: ") + std::strerror(errno);
+        munmap(ptr, mapped_length);
+        throw LoaderError(message);
+    }
+}
+
+
+AnonymousBuffer::~AnonymousBuffer()
+{
+    munmap(ptr, mapped_length);
+}
+
+
+void AnonymousBuffer::make_read_only()
+{
+    if (mprotect(ptr, mapped_length, PROT_READ) != 0) {
+        throw LoaderError(std::string("mprotect failed: ") + std::strerror(errno));
+    }
+}
+
+
+WritableSection::WritableSection(
+    char* mapping,
+    size_t mapping_length,
+    char* ptr,
+    size_t length,
+    bool copy_on_write
+):
+    mapping(mapping),
+    mapping_length(mapping_length),
+    ptr(ptr),
+    length(length),
+    copy_on_write(copy_on_write)
+{ }
+
+
+WritableSection::~WritableSection()
+{
+    munmap(mapping, mapping_length);
+}
+
+
+struct MappedFile::AccessTrace
+{
+    explicit AccessTrace(size_t section_count):
+        accessed(new std::atomic<bool>[section_count])
+    {
+        for (size_t i = 0; i < section_count; ++i) {
+            accessed[i].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void record(size_t index)
+    {
+        // Only the first access takes the lock
+        if (accessed[index].load(std::memory_order_relaxed) || accessed[index].exchange(true)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(index);
+    }
+
+    std::unique_ptr<std::atomic<bool>[]> accessed;
+    std::mutex mutex;
+    std::vector<size_t> order;
+};
+
+
+MappedFile::MappedFile(const std::string& path, const LoadOptions& options):
+    file_mapping(std::make_shared<const FileMapping>(path, options.huge_page_threshold != 0)),
+    image(file_mapping->data())
+{
+    load(options);
+}
+
+
+MappedFile::MappedFile(
+    std::shared_ptr<const FileMapping> mapping,
+    std::string_view image,
+    const LoadOptions& options
+):
+    file_mapping(std::move(mapping)),
+    image(image)
+{
+    load(options);
+}
+
+
+MappedFile::~MappedFile() = default;
+
+
+void MappedFile::load(const LoadOptions& options)
+{
+    header_info = read_early_header(image);
+
+    if (options.file_advice != AccessAdvice::normal) {
+        advise_range(image.data(), image.size(), options.file_advice);
+    }
+
+    auto body = image.substr(early_header_size);
+    section_table = visit_format(header_info.format_version.major, [this, body](auto parser) {
+        file_byte_order = parser.byte_order(body);
+        return parser.read_sections(body);
+    });
+    section_copies.resize(section_table.size());
+
+    if (options.trace_access) {
+        trace = std::make_unique<AccessTrace>(section_table.size());
+    }
+
+    if (options.huge_page_threshold != 0) {
+        auto threshold = std::max<uint64_t>(options.huge_page_threshold, huge_page_size);
+        for (size_t i = 0; i < section_table.size(); ++i) {
+            if (section_table[i].size >= threshold) {
+                use_huge_pages(i, options.module_cache);
+            }
+        }
+    }
+
+    if (options.deduplication_threshold != 0) {
+        auto& store = options.section_store != nullptr ? *options.section_store : SectionStore::global();
+        for (size_t i = 0; i < section_table.size(); ++i) {
+            if (section_copies[i].owner == nullptr && section_table[i].size >= options.deduplication_threshold) {
+                deduplicate(i, store, options.module_cache);
+            }
+        }
+    }
+
+    for (const auto& name : options.prefetch_sections) {
+        for (const auto& section : section_table) {
+            if (section.name == name) {
+                prefetch(section);
+            }
+        }
+    }
+}
+
+
+std::string MappedFile::cache_key(size_t index) const
+{
+    struct stat st;
+    if (fstat(file_mapping->fd(), &st) != 0) {
+        throw LoaderError(system_error_message("Unable to stat", file_mapping->path()));
+    }
+    std::ostringstream key;
+    key << st.st_dev << ':' << st.st_ino << ':' << st.st_size << ':' << st.st_mtim.tv_sec << '.'
+        << st.st_mtim.tv_nsec << ':' << (image.data() - file_mapping->data().data()) << ':' << index;
+    return key.str();
+}
+
+
+void MappedFile::use_huge_pages(size_t index, ModuleCacheClient* module_cache)
+{
+    auto data = mapped_section_data(section_table[index]);
+    auto begin = reinterpret_cast<uintptr_t>(data.data());
+
+    if (align_down(begin, huge_page_size) == begin) {
+        // The section is aligned in the file, so its mapping can be advised in place
+        auto end = align_down(begin + data.size(), huge_page_size);
+        if (end != begin && advise_huge_pages(data.data(), end - begin)) {
+            return;
+        }
+    }
+
+    if (module_cache != nullptr) {
+        try {
+            // On a hit the file's pages of the section are not even read
+            auto shared = module_cache->get_or_create("huge:" + cache_key(index), [data]() {
+                return std::string(data);
+            });
+            if (shared->data().size() == data.size()) {
+                auto mapping = std::make_shared<const HugePageSharedMapping>(*shared);
+                section_copies[index] = SectionCopy{mapping, mapping->data(), data.size(), mapping->capacity(), true};
+                advise_range(data.data(), data.size(), AccessAdvice::dont_need);
+                return;
+            }
+        } catch (const LoaderError&) {
+            // The cache is an optimization: without a broker, make a private copy
+        }
+    }
+
+    auto buffer = std::make_shared<AnonymousBuffer>(data.size(), huge_page_size);
+    // Advise before touching the memory so that the first faults already get huge pages
+    advise_huge_pages(buffer->data(), buffer->capacity());
+    std::memcpy(buffer->data(), data.data(), data.size());
+    buffer->make_read_only();
+    section_copies[index] = SectionCopy{buffer, buffer->data(), buffer->size(), buffer->capacity(), false};
+
+    // The mapped copy is not going to be used anymore
+    advise_range(data.data(), data.size(), AccessAdvice::dont_need);
+}
+
+
+void MappedFile::deduplicate(size_t index, SectionStore& store, ModuleCacheClient* module_cache)
+{
+    auto data = mapped_section_data(section_table[index]);
+    auto hash = content_hash(data);
+
+    if (module_cache != nullptr) {
+        std::ostringstream key;
+        key << "dedup:" << data.size() << ':' << std::hex << hash;
+        try {
+            auto shared = module_cache->get_or_create(key.str(), [data]() {
+                return std::string(data);
+            });
+            // The key is only a 64-bit hash, so the contents are compared
+            if (shared->data() == data) {
+                auto capacity = align_up(data.size(), size_t(sysconf(_SC_PAGESIZE)));
+                section_copies[index] = SectionCopy{shared, shared->data().data(), data.size(), capacity, true};
+                advise_range(data.data(), data.size(), AccessAdvice::dont_need);
+                return;
+            }
+        } catch (const LoaderError&) {
+            // The cache is an optimization: without a broker, share the copy within the process
+        }
+    }
+
+    auto buffer = store.get(data, hash);
+    section_copies[index] = SectionCopy{buffer, buffer->data(), buffer->size(), buffer->capacity(), false};
+    advise_range(data.data(), data.size(), AccessAdvice::dont_need);
+}
+
+
+size_t MappedFile::index_of(const v0::Section& section) const
+{
+    // References into `sections()` are resolved by identity (`std::less` gives a total order
+    // even for pointers to unrelated objects)
+    std::less<const v0::Section*> before;
+    const auto* first = section_table.data();
+    if (!before(&section, first) && before(&section, first + section_table.size())) {
+        return size_t(&section - first);
+    }
+
+    // Copies are looked up by offset. Sections are sorted by offset, but an empty section of a
+    // compact or footer table shares its offset with the next section, so the whole run of equal
+    // offsets is checked
+    auto it = std::lower_bound(
+        section_table.begin(),
+        section_table.end(),
+        section.offset,
+        [](const v0::Section& lhs, uint64_t offset) {
+            return lhs.offset < offset;
+        }
+    );
+    for (; it != section_table.end() && it->offset == section.offset; ++it) {
+        if (it->size == section.size && it->name == section.name) {
+            return size_t(it - section_table.begin());
+        }
+    }
+    throw LoaderError("Section does not belong to the file");
+}
+
+
+std::string_view MappedFile::backing_data(size_t index) const
+{
+    const auto& copy = section_copies[index];
+    if (copy.owner != nullptr) {
+        return std::string_view(copy.data, copy.size);
+    }
+    return mapped_section_data(section_table[index]);
+}
+
+
+std::string_view MappedFile::section_data(const v0::Section& section) const
+{
+    auto index = index_of(section);
+    if (trace != nullptr) {
+        trace->record(index);
+    }
+    return backing_data(index);
+}
+
+
+uint64_t MappedFile::file_offset(const v0::Section& section) const
+{
+    auto data = mapped_section_data(section);
+    return uint64_t(data.data() - file_mapping->data().data());
+}
+
+
+bool MappedFile::is_copied(const v0::Section& section) const
+{
+    return section_copies[index_of(section)].owner != nullptr;
+}
+
+
+std::vector<size_t> MappedFile::access_trace() const
+{
+    if (trace == nullptr) {
+        return {};
+    }
+    std::lock_guard<std::mutex> lock(trace->mutex);
+    return trace->order;
+}
+
+
+uint64_t MappedFile::huge_page_bytes(const v0::Section& section) const
+{
+    auto data = backing_data(index_of(section));
+    if (data.empty()) {
+        return 0;
+    }
+    return std::min<uint64_t>(smaps_huge_page_bytes(data.data()), data.size());
+}
+
+
+std::string_view MappedFile::mapped_section_data(const v0::Section& section) const
+{
+    auto body = image.substr(early_header_size);
+    if (section.offset > body.size() || section.size > body.size() - section.offset) {
+        throw LoaderError("Section is out of the file bounds");
+    }
+    return body.substr(section.offset, section.size);
+}
+
+
+const v0::Section* MappedFile::find_section(const std::array<char, 4>& name) const
+{
+    for (const auto& section : section_table) {
+        if (section.name == name) {
+            return &section;
+        }
+    }
+    return nullptr;
+}
+
+
+MemoryUsage MappedFile::memory_usage() const
+{
+    MemoryUsage usage;
+    usage.mapped_bytes = image.size();
+    usage.resident_bytes = resident_bytes(image.data(), image.size());
+    usage.heap_bytes = sizeof(*this)
+        + section_table.capacity() * sizeof(v0::Section)
+        + section_copies.capacity() * sizeof(SectionCopy);
+    if (trace != nullptr) {
+        usage.heap_bytes += sizeof(*trace) + section_table.size() * sizeof(std::atomic<bool>);
+        std::lock_guard<std::mutex> lock(trace->mutex);
+        usage.heap_bytes += trace->order.capacity() * sizeof(size_t);
+    }
+
+    usage.sections.reserve(section_table.size());
+    for (size_t i = 0; i < section_table.size(); ++i) {
+        auto mapped = mapped_section_data(section_table[i]);
+        auto [first, last] = page_range(mapped.data(), mapped.size());
+
+        SectionMemoryUsage section_usage;
+        section_usage.mapped_bytes = mapped.empty() ? 0 : last - first;
+        section_usage.copy_bytes = 0;
+        section_usage.shared_copy = false;
+
+        const auto& copy = section_copies[i];
+        if (copy.owner != nullptr) {
+            section_usage.resident_bytes = resident_bytes(copy.data, copy.size);
+            section_usage.copy_bytes = copy.capacity;
+            section_usage.shared_copy = copy.cross_process || copy.owner.use_count() > 1;
+            usage.resident_bytes += section_usage.resident_bytes;
+            usage.heap_bytes += section_usage.copy_bytes;
+        } else {
+            section_usage.resident_bytes = resident_bytes(mapped.data(), mapped.size());
+        }
+        usage.sections.push_back(section_usage);
+    }
+    return usage;
+}
+
+
+std::unique_ptr<WritableSection> MappedFile::map_writable(const v0::Section& section) const
+{
+    auto index = index_of(section);
+    auto page_size = size_t(sysconf(_SC_PAGESIZE));
+
+    if (section_copies[index].owner == nullptr && section.size >= page_size) {
+        auto offset = file_offset(section);
+        auto first = align_down(offset, page_size);
+        auto last = align_up(offset + section.size, page_size);
+        void* mapped = mmap(
+            nullptr,
+            last - first,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE,
+            file_mapping->fd(),
+            off_t(first)
+        );
+        // Falls back to copying, e.g. if the file system does not support private mappings
+        if (mapped != MAP_FAILED) {
+            auto mapping = static_cast<char*>(mapped);
+            return std::unique_ptr<WritableSection>(
+                new WritableSection(mapping, last - first, mapping + (offset - first), section.size, true)
+            );
+        }
+    }
+
+    auto data = backing_data(index);
+    auto mapping_length = align_up(std::max<size_t>(data.size(), 1), page_size);
+    void* mapped = mmap(nullptr, mapping_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        throw LoaderError(std::string("Unable to allocate anonymous memory: ") + std::strerror(errno));
+    }
+    auto mapping = static_cast<char*>(mapped);
+    std::memcpy(mapping, data.data(), data.size());
+    return std::unique_ptr<WritableSection>(
+        new WritableSection(mapping, mapping_length, mapping, data.size(), false)
+    );
+}
+
+
+void MappedFile::advise(const v0::Section& section, AccessAdvice advice) const
+{
+    auto index = index_of(section);
+    if (advice == AccessAdvice::dont_need && section_copies[index].owner != nullptr) {
+        return;
+    }
+    auto data = backing_data(index);
+    advise_range(data.data(), data.size(), advice);
+}
+
+}
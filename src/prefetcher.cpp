@@ -0,0 +1,218 @@
+#include <pex_loader/prefetcher.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+/// Size of the reads issued by the warming threads
+constexpr uint64_t chunk_size = uint64_t(1) << 20;
+
+
+/// Removes the parts of [begin, end) already covered by `ranges`, adds the rest to `ranges` and
+/// returns it
+std::vector<std::pair<uint64_t, uint64_t>> claim_range(
+    std::map<uint64_t, uint64_t>& ranges,
+    uint64_t begin,
+    uint64_t end,
+    uint64_t budget
+)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> claimed;
+
+    auto it = ranges.upper_bound(begin);
+    if (it != ranges.begin() && std::prev(it)->second > begin) {
+        begin = std::prev(it)->second;
+    }
+    while (begin < end && budget > 0) {
+        auto gap_end = (it != ranges.end()) ? std::min(end, it->first) : end;
+        if (begin < gap_end) {
+            auto claimed_end = begin + std::min(gap_end - begin, budget);
+            claimed.emplace_back(begin, claimed_end);
+            budget -= claimed_end - begin;
+            ranges.emplace(begin, claimed_end);
+        }
+        if (it == ranges.end()) {
+            break;
+        }
+        begin = std::max(begin, it->second);
+        ++it;
+    }
+    return claimed;
+}
+
+}
+
+
+Prefetcher::Prefetcher(uint64_t max_in_flight_bytes, size_t thread_count):
+    max_in_flight_bytes(max_in_flight_bytes),
+    in_flight(0),
+    busy_threads(0),
+    stopping(false)
+{
+    threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([this]() {
+            run();
+        });
+    }
+}
+
+
+Prefetcher::~Prefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    has_work.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+
+uint64_t Prefetcher::request(
+    const std::shared_ptr<const MappedFile>& file,
+    const std::vector<v0::Section>& sections
+)
+{
+    auto page_size = uint64_t(sysconf(_SC_PAGESIZE));
+    uint64_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        purge_expired();
+
+        auto& state = files[file.get()];
+        state.file = file;
+
+        for (const auto& section : sections) {
+            if (section.size == 0 || file->is_copied(section)) {
+                continue;
+            }
+            auto offset = file->file_offset(section);
+            auto begin = offset / page_size * page_size;
+            auto end = (offset + section.size + page_size - 1) / page_size * page_size;
+
+            auto budget = max_in_flight_bytes - std::min(max_in_flight_bytes, in_flight);
+            for (auto [range_begin, range_end] : claim_range(state.ranges, begin, end, budget)) {
+                queue.push_back(Task{file, range_begin, range_end - range_begin});
+                in_flight += range_end - range_begin;
+                queued += range_end - range_begin;
+            }
+        }
+    }
+    if (queued > 0) {
+        has_work.notify_all();
+    }
+    return queued;
+}
+
+
+void Prefetcher::purge_expired()
+{
+    for (auto it = files.begin(); it != files.end();) {
+        if (it->second.file.expired()) {
+            it = files.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+void Prefetcher::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (threads.empty()) {
+        while (!queue.empty()) {
+            process_next(lock);
+        }
+        return;
+    }
+    idle.wait(lock, [this]() {
+        return queue.empty() && busy_threads == 0;
+    });
+}
+
+
+uint64_t Prefetcher::in_flight_bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return in_flight;
+}
+
+
+void Prefetcher::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        has_work.wait(lock, [this]() {
+            return stopping || !queue.empty();
+        });
+        if (stopping) {
+            return;
+        }
+        process_next(lock);
+    }
+}
+
+
+void Prefetcher::process_next(std::unique_lock<std::mutex>& lock)
+{
+    auto task = std::move(queue.front());
+    queue.pop_front();
+    ++busy_threads;
+
+    lock.unlock();
+    warm(task);
+    lock.lock();
+
+    --busy_threads;
+    in_flight -= task.size;
+
+    // Only queued and in-progress ranges are deduplicated: the warmed pages may be evicted later,
+    // and must then be warmed again on request
+    auto state = files.find(task.file.get());
+    if (state != files.end()) {
+        state->second.ranges.erase(task.offset);
+    }
+
+    if (queue.empty() && busy_threads == 0) {
+        idle.notify_all();
+    }
+}
+
+
+void Prefetcher::warm(const Task& task)
+{
+    const auto& mapping = task.file->mapping();
+
+    // Start the reads asynchronously, then touch the pages so that the task only completes (and
+    // releases its share of the in-flight budget) once the data is in memory
+    posix_fadvise(mapping.fd(), off_t(task.offset), off_t(task.size), POSIX_FADV_WILLNEED);
+
+    auto page_size = uint64_t(sysconf(_SC_PAGESIZE));
+    const volatile char* data = mapping.data().data();
+    auto end = std::min<uint64_t>(task.offset + task.size, mapping.data().size());
+    for (auto chunk = task.offset; chunk < end; chunk += chunk_size) {
+        auto chunk_end = std::min(end, chunk + chunk_size);
+        for (auto offset = chunk; offset < chunk_end; offset += page_size) {
+            (void)data[offset];
+        }
+    }
+}
+
+}
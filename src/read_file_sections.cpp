@@ -0,0 +1,46 @@
+#include <pex_loader/format.hpp>
+
+#include <cstdint>
+#include <string>
+
+
+namespace pex::loader
+{
+
+void detail::throw_section_size_error(
+    uint64_t index,
+    uint64_t header_offset,
+    uint64_t encoded_size,
+    uint64_t data_size
+)
+{
+    auto prefix = "Section " + std::to_string(index) + " at offset " + std::to_string(header_offset);
+    if (encoded_size < 4) {
+        throw LoaderError(
+            prefix + " has invalid encoded size " + std::to_string(encoded_size)
+            + " (it must include the 4-byte section name)"
+        );
+    }
+    auto data_offset = header_offset + 12;
+    auto size = encoded_size - 4;
+    if (size > UINT64_MAX - data_offset) {
+        throw LoaderError(prefix + " has size " + std::to_string(size) + " which overflows the file offset");
+    }
+    throw LoaderError(
+        "Unexpected EOF while reading data of section " + std::to_string(index) + ": it ends at offset "
+        + std::to_string(data_offset + size) + ", past the end of the section table at "
+        + std::to_string(data_size)
+    );
+}
+
+
+std::vector<v0::Section> read_file_sections(std::string_view data)
+{
+    auto header = read_early_header(data);
+    auto body = data.substr(early_header_size);
+    return visit_format(header.format_version.major, [body](auto parser) {
+        return parser.read_sections(body);
+    });
+}
+
+}
@@ -0,0 +1,510 @@
+#include <pex_loader/scanner.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+#include <pex_loader/detail/varint.hpp>
+#include <pex_loader/format.hpp>
+#include <pex_loader/mapped_file.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+std::string system_error_message(const std::string& what, const std::string& path)
+{
+    return what + " '" + path + "': " + std::strerror(errno);
+}
+
+
+/// Reads a file with large aligned reads, with or without `O_DIRECT`
+class SequentialReader
+{
+public:
+    SequentialReader(const std::string& path, size_t read_size, bool direct_io):
+        path(path),
+        page_size(size_t(sysconf(_SC_PAGESIZE))),
+        buffer((std::max(read_size, page_size) + page_size - 1) / page_size * page_size, page_size),
+        direct_io(false)
+    {
+        if (direct_io) {
+            fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+            this->direct_io = fd >= 0;
+        }
+        if (fd < 0) {
+            open_buffered();
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            auto message = system_error_message("Unable to stat", path);
+            close(fd);
+            throw LoaderError(message);
+        }
+        file_size = uint64_t(st.st_size);
+    }
+
+    ~SequentialReader()
+    {
+        close(fd);
+    }
+
+    SequentialReader(const SequentialReader&) = delete;
+    SequentialReader& operator=(const SequentialReader&) = delete;
+
+    uint64_t size() const
+    {
+        return file_size;
+    }
+
+    bool is_direct() const
+    {
+        return direct_io;
+    }
+
+    /// Reads the next chunk; returns an empty view at the end of the file
+    std::string_view next()
+    {
+        if (position >= file_size) {
+            return {};
+        }
+        auto data = read_at(position, buffer.size());
+        if (data.empty()) {
+            throw LoaderError("File '" + path + "' was truncated while scanning");
+        }
+        position += data.size();
+        return data;
+    }
+
+    /// Restarts sequential reading from the beginning of the file
+    void rewind()
+    {
+        position = 0;
+    }
+
+    /// Reads `size` bytes at `offset` with aligned reads (this overwrites the last chunk)
+    std::string read_range(uint64_t offset, uint64_t size)
+    {
+        std::string out;
+        out.reserve(size);
+        while (out.size() < size) {
+            auto current = offset + out.size();
+            auto aligned = current / page_size * page_size;
+            auto data = read_at(aligned, buffer.size());
+            if (data.size() <= current - aligned) {
+                throw LoaderError("File '" + path + "' was truncated while scanning");
+            }
+            data = data.substr(current - aligned, size - out.size());
+            out += data;
+        }
+        return out;
+    }
+
+private:
+    void open_buffered()
+    {
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw LoaderError(system_error_message("Unable to open", path));
+        }
+        direct_io = false;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+    }
+
+    /// Records which pages of the file are in the page cache before the scan reads them, so that
+    /// it only drops the pages it brings in itself (another process may be using the others)
+    ///
+    /// The whole file is checked at once: checking chunk by chunk would see the pages read ahead
+    /// by the kernel for the previous chunk as cached. The file is mapped only to query `mincore`,
+    /// its pages are never touched. If the residency cannot be determined, every page is considered
+    /// cached and none is dropped.
+    void snapshot_residency()
+    {
+        auto page_count = size_t((file_size + page_size - 1) / page_size);
+        resident.assign(page_count, 1);
+        has_residency = true;
+        if (page_count == 0) {
+            return;
+        }
+        auto map = mmap(nullptr, size_t(file_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            return;
+        }
+        if (mincore(map, size_t(file_size), resident.data()) != 0) {
+            resident.assign(page_count, 1);
+        }
+        munmap(map, size_t(file_size));
+    }
+
+    /// Drops the pages of `[offset, offset + size)` which were not cached before the scan
+    void drop_read_pages(uint64_t offset, size_t size)
+    {
+        auto first = offset / page_size;
+        auto last = std::min<uint64_t>(resident.size(), (offset + size + page_size - 1) / page_size);
+        for (auto begin = first; begin < last;) {
+            if (resident[begin] & 1) {
+                ++begin;
+                continue;
+            }
+            auto end = begin + 1;
+            while (end < last && (resident[end] & 1) == 0) {
+                ++end;
+            }
+            posix_fadvise(fd, off_t(begin * page_size), off_t((end - begin) * page_size), POSIX_FADV_DONTNEED);
+            begin = end;
+        }
+    }
+
+    /// Reads up to `size` bytes at an aligned `offset` into the buffer
+    std::string_view read_at(uint64_t offset, size_t size)
+    {
+        ssize_t result;
+        while (true) {
+            if (!direct_io && !has_residency) {
+                snapshot_residency();
+            }
+            result = pread(fd, buffer.data(), size, off_t(offset));
+            if (result >= 0) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL && direct_io) {
+                // The file system accepted O_DIRECT at open time but rejects the alignment
+                close(fd);
+                open_buffered();
+                continue;
+            }
+            throw LoaderError(system_error_message("Unable to read", path));
+        }
+        auto data = std::string_view(buffer.data(), std::min<uint64_t>(uint64_t(result), file_size - offset));
+        if (!direct_io && result > 0) {
+            drop_read_pages(offset, size_t(result));
+        }
+        return data;
+    }
+
+    std::string path;
+    size_t page_size;
+    AnonymousBuffer buffer;
+    int fd = -1;
+    bool direct_io;
+    uint64_t file_size;
+    uint64_t position = 0;
+
+    bool has_residency = false;
+    std::vector<unsigned char> resident;
+};
+
+
+/// Validates a section table while the part of the file after the early header streams by
+///
+/// Tables interleaved with the data (version 0 and plain version 1 tables) are parsed header by
+/// header, skipping the data in between. Compact tables are decoded byte by byte, since they are
+/// small and precede all the data. The records are checked by the same helpers as the in-memory
+/// walks of format.hpp.
+class SectionTableStream
+{
+public:
+    enum class Layout
+    {
+        interleaved,
+        compact,
+        /// The table was read separately, only the size is checked
+        none,
+    };
+
+    SectionTableStream(Layout layout, ByteOrder order, uint64_t table_offset, uint64_t body_size):
+        layout(layout),
+        order(order),
+        body_size(body_size),
+        next_record(table_offset),
+        done(layout == Layout::none)
+    { }
+
+    void feed(std::string_view data)
+    {
+        while (!data.empty()) {
+            if (done || position < next_record) {
+                auto skipped = done ? data.size() : size_t(std::min<uint64_t>(data.size(), next_record - position));
+                position += skipped;
+                data.remove_prefix(skipped);
+                continue;
+            }
+            if (layout == Layout::interleaved) {
+                auto taken = std::min(data.size(), record_size - pending_size);
+                std::memcpy(pending.data() + pending_size, data.data(), taken);
+                pending_size += taken;
+                position += taken;
+                data.remove_prefix(taken);
+                if (pending_size == record_size) {
+                    interleaved_record();
+                }
+            } else {
+                ++position;
+                compact_byte(uint8_t(data.front()));
+                data.remove_prefix(1);
+            }
+        }
+    }
+
+    std::vector<v0::Section> finish()
+    {
+        if (position != body_size) {
+            throw LoaderError("Scanned size does not match the file size");
+        }
+        if (!done) {
+            throw LoaderError(
+                "Unexpected EOF while reading section table: " + std::to_string(sections.size())
+                + " sections read"
+            );
+        }
+        return std::move(sections);
+    }
+
+private:
+    void interleaved_record()
+    {
+        pending_size = 0;
+        if (!has_count) {
+            section_count = detail::load<uint64_t>(order, pending.data());
+            has_count = true;
+            record_size = 12;
+            next_record = position;
+            done = section_count == 0;
+            return;
+        }
+
+        auto header_offset = position - 12;
+        auto section = order == ByteOrder::little
+            ? detail::read_section_header<ByteOrder::little>(pending.data(), sections.size(), header_offset, body_size)
+            : detail::read_section_header<ByteOrder::big>(pending.data(), sections.size(), header_offset, body_size);
+        sections.push_back(section);
+
+        next_record = section.offset + section.size;
+        done = sections.size() == section_count;
+    }
+
+    void compact_byte(uint8_t byte)
+    {
+        if (compact_state == CompactState::names) {
+            names.push_back(char(byte));
+            if (names.size() == name_count * 4) {
+                start_entries();
+            }
+            return;
+        }
+
+        if (detail::uleb128_step(varint, varint_shift, byte)) {
+            return;
+        }
+        auto value = varint;
+        varint = 0;
+        varint_shift = 0;
+
+        switch (compact_state) {
+            case CompactState::section_count: {
+                // Every entry takes at least two bytes
+                if (value > (body_size - position) / 2) {
+                    throw LoaderError("Unexpected EOF while reading section table");
+                }
+                section_count = value;
+                compact_state = CompactState::name_count;
+                break;
+            }
+            case CompactState::name_count: {
+                if (value > (body_size - position) / 4) {
+                    throw LoaderError("Unexpected EOF while reading section names");
+                }
+                name_count = value;
+                names.reserve(name_count * 4);
+                if (name_count != 0) {
+                    compact_state = CompactState::names;
+                } else {
+                    start_entries();
+                }
+                break;
+            }
+            case CompactState::entries: {
+                entries.push_back(value);
+                if (entries.size() == section_count * 2) {
+                    finish_compact();
+                }
+                break;
+            }
+            case CompactState::names: {
+                break;
+            }
+        }
+    }
+
+    void start_entries()
+    {
+        compact_state = CompactState::entries;
+        if (section_count == 0) {
+            finish_compact();
+        }
+    }
+
+    /// Lays out the sections once the whole compact table has been decoded
+    void finish_compact()
+    {
+        uint64_t offset = position;
+        sections.reserve(section_count);
+        for (uint64_t i = 0; i < section_count; ++i) {
+            auto section = detail::read_compact_entry(
+                entries[i * 2],
+                entries[i * 2 + 1],
+                names.data(),
+                name_count,
+                offset,
+                body_size
+            );
+            sections.push_back(section);
+        }
+        entries.clear();
+        entries.shrink_to_fit();
+        done = true;
+    }
+
+    enum class CompactState
+    {
+        section_count,
+        name_count,
+        names,
+        entries,
+    };
+
+    Layout layout;
+    ByteOrder order;
+    uint64_t body_size;
+    uint64_t position = 0;
+    uint64_t next_record;
+    bool done;
+
+    std::array<char, 12> pending;
+    size_t pending_size = 0;
+    size_t record_size = 8;
+    bool has_count = false;
+    uint64_t section_count = 0;
+
+    CompactState compact_state = CompactState::section_count;
+    uint64_t varint = 0;
+    unsigned varint_shift = 0;
+    uint64_t name_count = 0;
+    std::string names;
+    std::vector<uint64_t> entries;
+
+    std::vector<v0::Section> sections;
+};
+
+
+/// Reads and validates a footer section table (see `v1::footer_table`) with positioned reads
+template <ByteOrder Order>
+std::vector<v0::Section> read_footer_table(SequentialReader& reader)
+{
+    using detail::footer_size;
+    using detail::footer_entry_size;
+
+    auto body_size = reader.size() - early_header_size;
+    if (body_size < footer_size) {
+        throw LoaderError("Unexpected EOF while reading section table footer");
+    }
+    auto footer_data = reader.read_range(reader.size() - footer_size, footer_size);
+    auto footer = detail::read_footer<Order>(footer_data.data(), body_size);
+
+    auto table = reader.read_range(early_header_size + footer.table_offset, footer.section_count * footer_entry_size);
+    std::vector<v0::Section> sections;
+    sections.reserve(footer.section_count);
+    uint64_t previous_end = 4;
+    for (uint64_t i = 0; i < footer.section_count; ++i) {
+        const char* entry = table.data() + i * footer_entry_size;
+        sections.push_back(detail::read_footer_entry<Order>(entry, footer.table_offset, previous_end));
+    }
+    return sections;
+}
+
+}
+
+
+ScanResult scan_file(const std::string& path, const ScanOptions& options)
+{
+    SequentialReader reader(path, options.read_size, options.direct_io);
+
+    ScanResult result;
+    result.file_size = reader.size();
+
+    // The first chunk is at least a page, so it holds the early header and the feature flags
+    auto chunk = reader.next();
+    result.header = read_early_header(chunk);
+    auto body_size = reader.size() - early_header_size;
+
+    std::unique_ptr<SectionTableStream> table;
+    auto major = result.header.format_version.major;
+    if (major == 0) {
+        table = std::make_unique<SectionTableStream>(
+            SectionTableStream::Layout::interleaved,
+            ByteOrder::big,
+            0,
+            body_size
+        );
+    } else if (major == 1) {
+        auto flags = v1::read_feature_flags(chunk.substr(early_header_size));
+        auto order = v1::byte_order(flags);
+        if (flags & v1::compact_table) {
+            table = std::make_unique<SectionTableStream>(SectionTableStream::Layout::compact, order, 4, body_size);
+        } else if (flags & v1::footer_table) {
+            result.sections = order == ByteOrder::little
+                ? read_footer_table<ByteOrder::little>(reader)
+                : read_footer_table<ByteOrder::big>(reader);
+            // The positioned reads reused the buffer holding the first chunk
+            reader.rewind();
+            chunk = reader.next();
+            table = std::make_unique<SectionTableStream>(SectionTableStream::Layout::none, order, 0, body_size);
+        } else {
+            table = std::make_unique<SectionTableStream>(
+                SectionTableStream::Layout::interleaved,
+                order,
+                4,
+                body_size
+            );
+        }
+    } else {
+        throw LoaderError("Unsupported format major version: " + std::to_string(major));
+    }
+
+    uint64_t offset = 0;
+    for (; !chunk.empty(); chunk = reader.next()) {
+        if (options.on_data) {
+            options.on_data(offset, chunk);
+        }
+        auto body_part = offset >= early_header_size ? chunk : chunk.substr(early_header_size - offset);
+        table->feed(body_part);
+        offset += chunk.size();
+    }
+
+    auto streamed_sections = table->finish();
+    if (result.sections.empty()) {
+        result.sections = std::move(streamed_sections);
+    }
+    result.direct_io = reader.is_direct();
+    return result;
+}
+
+}
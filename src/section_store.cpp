@@ -0,0 +1,85 @@
+#include <pex_loader/section_store.hpp>
+
+#include <cstring>
+
+#include <unistd.h>
+
+
+namespace pex::loader
+{
+
+std::shared_ptr<const AnonymousBuffer> SectionStore::get(std::string_view contents)
+{
+    return get(contents, content_hash(contents));
+}
+
+
+std::shared_ptr<const AnonymousBuffer> SectionStore::get(std::string_view contents, uint64_t hash)
+{
+    // Returns the live buffer with the given contents, dropping the expired ones on the way
+    auto find = [this, contents, hash]() -> std::shared_ptr<const AnonymousBuffer> {
+        auto candidates = buffers.find(hash);
+        if (candidates == buffers.end()) {
+            return nullptr;
+        }
+        std::shared_ptr<const AnonymousBuffer> found;
+        auto& list = candidates->second;
+        for (auto it = list.begin(); it != list.end();) {
+            auto buffer = it->lock();
+            if (buffer == nullptr) {
+                it = list.erase(it);
+                continue;
+            }
+            if (found == nullptr && std::string_view(buffer->data(), buffer->size()) == contents) {
+                found = std::move(buffer);
+            }
+            ++it;
+        }
+        if (list.empty()) {
+            buffers.erase(candidates);
+        }
+        return found;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto buffer = find()) {
+            return buffer;
+        }
+    }
+
+    // The copy is made without holding the lock; if another caller published the same contents
+    // meanwhile, its buffer wins and this one is dropped
+    auto buffer = std::make_shared<AnonymousBuffer>(contents.size(), size_t(sysconf(_SC_PAGESIZE)));
+    std::memcpy(buffer->data(), contents.data(), contents.size());
+    buffer->make_read_only();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto existing = find()) {
+        return existing;
+    }
+    buffers[hash].push_back(buffer);
+    return buffer;
+}
+
+
+size_t SectionStore::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto& [hash, candidates] : buffers) {
+        for (const auto& candidate : candidates) {
+            total += candidate.expired() ? 0 : 1;
+        }
+    }
+    return total;
+}
+
+
+SectionStore& SectionStore::global()
+{
+    static SectionStore store;
+    return store;
+}
+
+}
@@ -0,0 +1,522 @@
+#include <pex_loader/shared_cache.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+
+constexpr char get_request = 'G';
+constexpr char put_request = 'P';
+constexpr size_t max_key_size = 4096;
+/// Accepted connections beyond this many waiting ones are dropped
+constexpr size_t max_pending_connections = 128;
+constexpr int required_seals = F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+
+
+std::string system_error_message(const std::string& what)
+{
+    return what + ": " + std::strerror(errno);
+}
+
+
+sockaddr_un make_address(const std::string& socket_path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw LoaderError("Socket path is too long: '" + socket_path + "'");
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+
+/// Closes the file descriptor when going out of scope
+struct FileDescriptor
+{
+    ~FileDescriptor()
+    {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    int fd;
+};
+
+
+/// Bounds how long sends and receives on the socket may block
+void set_timeouts(int socket_fd, std::chrono::milliseconds timeout)
+{
+    timeval value{};
+    value.tv_sec = time_t(timeout.count() / 1000);
+    value.tv_usec = suseconds_t(timeout.count() % 1000 * 1000);
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &value, sizeof(value)) != 0
+        || setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value)) != 0) {
+        throw LoaderError(system_error_message("Unable to set socket timeouts"));
+    }
+}
+
+
+/// Sends a single message, optionally passing a file descriptor
+void send_message(int socket_fd, std::string_view message, int passed_fd)
+{
+    iovec iov{const_cast<char*>(message.data()), message.size()};
+    msghdr header{};
+    header.msg_iov = &iov;
+    header.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    if (passed_fd >= 0) {
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+        auto cmsg = CMSG_FIRSTHDR(&header);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &passed_fd, sizeof(int));
+    }
+
+    while (sendmsg(socket_fd, &header, MSG_NOSIGNAL) < 0) {
+        if (errno != EINTR) {
+            throw LoaderError(system_error_message("Unable to send a message to the module broker"));
+        }
+    }
+}
+
+
+/// Receives a single message and the file descriptor passed with it (or -1)
+std::string receive_message(int socket_fd, int& passed_fd)
+{
+    std::vector<char> buffer(1 + 4 + max_key_size);
+    iovec iov{buffer.data(), buffer.size()};
+    msghdr header{};
+    header.msg_iov = &iov;
+    header.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    while ((received = recvmsg(socket_fd, &header, MSG_CMSG_CLOEXEC)) < 0) {
+        if (errno != EINTR) {
+            throw LoaderError(system_error_message("Unable to receive a message from the module broker"));
+        }
+    }
+
+    passed_fd = -1;
+    for (auto cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&passed_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if (header.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        if (passed_fd >= 0) {
+            close(passed_fd);
+        }
+        throw LoaderError("Module broker message is too large");
+    }
+    return std::string(buffer.data(), size_t(received));
+}
+
+
+std::string make_request(char kind, const std::string& key)
+{
+    if (key.size() > max_key_size) {
+        throw LoaderError("Module cache key is too long");
+    }
+    std::string request(1, kind);
+    detail::append_be<uint32_t>(request, uint32_t(key.size()));
+    request += key;
+    return request;
+}
+
+}
+
+
+SealedBuffer::SealedBuffer(int fd, size_t size):
+    file_descriptor(fd),
+    ptr(nullptr),
+    length(size)
+{
+    if (length == 0) {
+        return;
+    }
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        auto message = system_error_message("Unable to map a sealed buffer");
+        close(fd);
+        throw LoaderError(message);
+    }
+    ptr = static_cast<char*>(mapped);
+}
+
+
+SealedBuffer::~SealedBuffer()
+{
+    if (ptr != nullptr) {
+        munmap(ptr, length);
+    }
+    close(file_descriptor);
+}
+
+
+std::shared_ptr<const SealedBuffer> SealedBuffer::create(const std::string& name, std::string_view contents)
+{
+    // memfd names are limited to 249 bytes; they only show up in /proc, so a prefix will do
+    int fd = memfd_create(name.substr(0, 200).c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        throw LoaderError(system_error_message("Unable to create a memfd"));
+    }
+
+    const char* data = contents.data();
+    size_t remaining = contents.size();
+    while (remaining > 0) {
+        auto written = write(fd, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            auto message = system_error_message("Unable to write a memfd");
+            close(fd);
+            throw LoaderError(message);
+        }
+        data += written;
+        remaining -= size_t(written);
+    }
+
+    if (fcntl(fd, F_ADD_SEALS, required_seals) != 0) {
+        auto message = system_error_message("Unable to seal a memfd");
+        close(fd);
+        throw LoaderError(message);
+    }
+    return std::shared_ptr<const SealedBuffer>(new SealedBuffer(fd, contents.size()));
+}
+
+
+std::shared_ptr<const SealedBuffer> SealedBuffer::adopt(int fd)
+{
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & required_seals) != required_seals) {
+        close(fd);
+        throw LoaderError("Received a buffer which is not sealed");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        auto message = system_error_message("Unable to stat a sealed buffer");
+        close(fd);
+        throw LoaderError(message);
+    }
+    return std::shared_ptr<const SealedBuffer>(new SealedBuffer(fd, size_t(st.st_size)));
+}
+
+
+ModuleBroker::ModuleBroker(const std::string& socket_path, const BrokerOptions& options):
+    socket_path(socket_path),
+    options(options),
+    listen_fd(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0))
+{
+    if (listen_fd < 0) {
+        throw LoaderError(system_error_message("Unable to create the module broker socket"));
+    }
+    auto address = make_address(socket_path);
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listen_fd, SOMAXCONN) != 0) {
+        auto message = system_error_message("Unable to listen on '" + socket_path + "'");
+        close(listen_fd);
+        throw LoaderError(message);
+    }
+
+    for (size_t i = 0; i < std::max<size_t>(options.thread_count, 1); ++i) {
+        workers.emplace_back([this]() {
+            serve_connections();
+        });
+    }
+    acceptor = std::thread([this]() {
+        accept_connections();
+    });
+}
+
+
+ModuleBroker::~ModuleBroker()
+{
+    // Wakes up the blocked accept()
+    shutdown(listen_fd, SHUT_RDWR);
+    acceptor.join();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_ready.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (int connection : pending) {
+        close(connection);
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+}
+
+
+size_t ModuleBroker::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return modules.size();
+}
+
+
+uint64_t ModuleBroker::bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_bytes;
+}
+
+
+void ModuleBroker::accept_connections()
+{
+    while (true) {
+        int connection = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Out of resources: wait for the workers to close some connections
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            return;
+        }
+
+        try {
+            // A client which stops sending or receiving only holds its worker until the timeout
+            set_timeouts(connection, options.timeout);
+        } catch (const LoaderError&) {
+            close(connection);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (pending.size() < max_pending_connections) {
+                pending.push_back(connection);
+                connection = -1;
+            }
+        }
+        if (connection >= 0) {
+            close(connection);
+        } else {
+            queue_ready.notify_one();
+        }
+    }
+}
+
+
+void ModuleBroker::serve_connections()
+{
+    while (true) {
+        int connection;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_ready.wait(lock, [this]() {
+                return stopping || !pending.empty();
+            });
+            if (stopping) {
+                return;
+            }
+            connection = pending.front();
+            pending.pop_front();
+        }
+        try {
+            handle(connection);
+        } catch (const LoaderError&) {
+            // A misbehaving client only loses its own request
+        }
+        close(connection);
+    }
+}
+
+
+void ModuleBroker::handle(int connection)
+{
+    int passed_fd;
+    auto request = receive_message(connection, passed_fd);
+    std::shared_ptr<const SealedBuffer> passed;
+    if (passed_fd >= 0) {
+        passed = SealedBuffer::adopt(passed_fd);
+    }
+
+    if (request.size() < 5 || detail::load_be<uint32_t>(request.data() + 1) != request.size() - 5) {
+        throw LoaderError("Malformed module broker request");
+    }
+    auto key = request.substr(5);
+
+    if (request[0] == get_request) {
+        auto module = find(key);
+        send_message(connection, module != nullptr ? "1" : "0", module != nullptr ? module->fd() : -1);
+    } else if (request[0] == put_request && passed != nullptr) {
+        bool inserted = may_publish(connection) && insert(key, std::move(passed));
+        send_message(connection, inserted ? "1" : "0", -1);
+    } else {
+        throw LoaderError("Malformed module broker request");
+    }
+}
+
+
+bool ModuleBroker::may_publish(int connection) const
+{
+    ucred credentials{};
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+    return credentials.uid == geteuid()
+        || std::find(options.allowed_uids.begin(), options.allowed_uids.end(), credentials.uid)
+            != options.allowed_uids.end();
+}
+
+
+std::shared_ptr<const SealedBuffer> ModuleBroker::find(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = modules.find(key);
+    if (it == modules.end()) {
+        return nullptr;
+    }
+    recency.splice(recency.begin(), recency, it->second.position);
+    return it->second.buffer;
+}
+
+
+bool ModuleBroker::insert(const std::string& key, std::shared_ptr<const SealedBuffer> buffer)
+{
+    auto size = buffer->data().size();
+    if (options.max_bytes != 0 && size > options.max_bytes) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (modules.count(key) != 0) {
+        return false;
+    }
+    recency.push_front(key);
+    modules.emplace(key, Module{std::move(buffer), recency.begin()});
+    total_bytes += size;
+
+    while (options.max_bytes != 0 && total_bytes > options.max_bytes) {
+        auto evicted = modules.find(recency.back());
+        total_bytes -= evicted->second.buffer->data().size();
+        modules.erase(evicted);
+        recency.pop_back();
+    }
+    return true;
+}
+
+
+ModuleCacheClient::ModuleCacheClient(std::string socket_path, std::chrono::milliseconds timeout):
+    socket_path(std::move(socket_path)),
+    timeout(timeout)
+{ }
+
+
+namespace
+{
+
+/// Sends a request to the broker and returns its one-byte status and the passed descriptor
+char exchange(
+    const std::string& socket_path,
+    std::chrono::milliseconds timeout,
+    const std::string& request,
+    int request_fd,
+    int& reply_fd
+)
+{
+    FileDescriptor connection{socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)};
+    if (connection.fd < 0) {
+        throw LoaderError(system_error_message("Unable to create a socket"));
+    }
+    set_timeouts(connection.fd, timeout);
+    auto address = make_address(socket_path);
+    if (connect(connection.fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        throw LoaderError(system_error_message("Unable to connect to the module broker at '" + socket_path + "'"));
+    }
+
+    send_message(connection.fd, request, request_fd);
+    auto reply = receive_message(connection.fd, reply_fd);
+    if (reply.size() != 1) {
+        if (reply_fd >= 0) {
+            close(reply_fd);
+        }
+        throw LoaderError("Malformed module broker reply");
+    }
+    return reply[0];
+}
+
+}
+
+
+std::shared_ptr<const SealedBuffer> ModuleCacheClient::fetch(const std::string& key) const
+{
+    int fd;
+    auto status = exchange(socket_path, timeout, make_request(get_request, key), -1, fd);
+    if (status != '1' || fd < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return nullptr;
+    }
+    return SealedBuffer::adopt(fd);
+}
+
+
+bool ModuleCacheClient::publish(const std::string& key, const SealedBuffer& buffer) const
+{
+    int fd;
+    auto status = exchange(socket_path, timeout, make_request(put_request, key), buffer.fd(), fd);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return status == '1';
+}
+
+
+std::shared_ptr<const SealedBuffer> ModuleCacheClient::get_or_create(
+    const std::string& key,
+    const std::function<std::string()>& materialize
+) const
+{
+    if (auto module = fetch(key)) {
+        return module;
+    }
+
+    auto created = SealedBuffer::create(key, materialize());
+    if (publish(key, *created)) {
+        return created;
+    }
+    // Somebody else published it first: use theirs, so that only one copy stays alive
+    if (auto module = fetch(key)) {
+        return module;
+    }
+    return created;
+}
+
+}
@@ -0,0 +1,143 @@
+#include <pex_loader/string_table.hpp>
+
+#include <cstring>
+
+
+namespace pex::loader
+{
+
+namespace
+{
+    constexpr size_t block_size = 64 * 1024;
+}
+
+
+StringInterner::Shard& StringInterner::shard_for(uint32_t hash) const
+{
+    // Low bits select the slot inside a shard, so take the shard index from the high ones
+    return shards[(hash >> 28) % shard_count];
+}
+
+
+void StringInterner::grow(Shard& shard)
+{
+    std::vector<Slot> old_slots(shard.slots.empty() ? 64 : shard.slots.size() * 2);
+    old_slots.swap(shard.slots);
+
+    auto mask = shard.slots.size() - 1;
+    for (const auto& slot : old_slots) {
+        if (!slot.used) {
+            continue;
+        }
+        auto i = slot.hash & mask;
+        while (shard.slots[i].used) {
+            i = (i + 1) & mask;
+        }
+        shard.slots[i] = slot;
+    }
+}
+
+
+std::string_view StringInterner::store(Shard& shard, std::string_view str)
+{
+    if (str.empty()) {
+        return {};
+    }
+    if (str.size() > shard.block_free) {
+        // Long strings get a block of their own, so they do not waste the rest of the current one
+        if (str.size() > block_size / 4) {
+            std::unique_ptr<char[]> block(new char[str.size()]);
+            std::memcpy(block.get(), str.data(), str.size());
+            std::string_view copy(block.get(), str.size());
+            // The block with free space, if any, stays last
+            shard.blocks.insert(shard.blocks.end() - (shard.block_free != 0), std::move(block));
+            return copy;
+        }
+        shard.blocks.emplace_back(new char[block_size]);
+        shard.block_free = block_size;
+    }
+    auto* dest = shard.blocks.back().get() + (block_size - shard.block_free);
+    std::memcpy(dest, str.data(), str.size());
+    shard.block_free -= str.size();
+    return {dest, str.size()};
+}
+
+
+std::string_view StringInterner::intern(std::string_view str, uint32_t hash)
+{
+    auto& shard = shard_for(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Keep the load factor below 3/4
+    if ((shard.used_count + 1) * 4 > shard.slots.size() * 3) {
+        grow(shard);
+    }
+
+    auto mask = shard.slots.size() - 1;
+    for (auto i = hash & mask;; i = (i + 1) & mask) {
+        auto& slot = shard.slots[i];
+        if (!slot.used) {
+            // Every stored hash is checked, so a lookup with a wrong hash never matches
+            if (name_hash(str) != hash) {
+                throw LoaderError("String hash does not match its contents");
+            }
+            slot = Slot{hash, store(shard, str), true};
+            ++shard.used_count;
+            return slot.str;
+        }
+        if (slot.hash == hash && slot.str == str) {
+            return slot.str;
+        }
+    }
+}
+
+
+std::string_view StringInterner::intern(std::string_view str)
+{
+    return intern(str, name_hash(str));
+}
+
+
+std::optional<std::string_view> StringInterner::find(std::string_view str, uint32_t hash) const
+{
+    auto& shard = shard_for(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.slots.empty()) {
+        return std::nullopt;
+    }
+
+    auto mask = shard.slots.size() - 1;
+    for (auto i = hash & mask; shard.slots[i].used; i = (i + 1) & mask) {
+        const auto& slot = shard.slots[i];
+        if (slot.hash == hash && slot.str == str) {
+            return slot.str;
+        }
+    }
+    return std::nullopt;
+}
+
+
+std::optional<std::string_view> StringInterner::find(std::string_view str) const
+{
+    return find(str, name_hash(str));
+}
+
+
+size_t StringInterner::size() const
+{
+    size_t total = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.used_count;
+    }
+    return total;
+}
+
+
+StringInterner& StringInterner::global()
+{
+    static StringInterner interner;
+    return interner;
+}
+
+}
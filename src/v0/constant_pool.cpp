@@ -0,0 +1,161 @@
+#include <pex_loader/constant_pool.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+
+namespace pex::loader::v0
+{
+
+namespace
+{
+
+constexpr uint8_t integer_tag = 0;
+constexpr uint8_t float_tag = 1;
+constexpr uint8_t string_tag = 2;
+
+}
+
+
+ConstantPool::ConstantPool(std::string_view section_data, ByteOrder order):
+    order(order)
+{
+    if (section_data.size() < 4) {
+        throw LoaderError("Unexpected EOF while reading constant pool header");
+    }
+    constant_count = detail::load<uint32_t>(order, section_data.data());
+
+    // The count is 32-bit, so 64-bit arithmetic cannot overflow here
+    uint64_t data_offset = 4 + (uint64_t(constant_count) + 1) * 4;
+    if (data_offset > section_data.size()) {
+        throw LoaderError("Unexpected EOF while reading constant pool offsets");
+    }
+    offsets = section_data.data() + 4;
+    data = section_data.substr(data_offset);
+
+    constants.reset(new std::atomic<const Constant*>[constant_count]);
+    for (uint32_t i = 0; i < constant_count; ++i) {
+        constants[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+
+ConstantPool::~ConstantPool()
+{
+    for (uint32_t i = 0; i < constant_count; ++i) {
+        delete constants[i].load(std::memory_order_relaxed);
+    }
+}
+
+
+const Constant& ConstantPool::operator[](uint32_t index) const
+{
+    if (index >= constant_count) {
+        throw LoaderError("Constant index out of range: " + std::to_string(index));
+    }
+
+    auto& slot = constants[index];
+    const Constant* constant = slot.load(std::memory_order_acquire);
+    if (constant != nullptr) {
+        return *constant;
+    }
+
+    auto decoded = std::make_unique<const Constant>(decode(index));
+    if (slot.compare_exchange_strong(constant, decoded.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return *decoded.release();
+    }
+    // Another thread published the constant first, `constant` now points to its copy
+    return *constant;
+}
+
+
+uint32_t ConstantPool::decoded_count() const
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < constant_count; ++i) {
+        count += constants[i].load(std::memory_order_relaxed) != nullptr ? 1 : 0;
+    }
+    return count;
+}
+
+
+Constant ConstantPool::decode(uint32_t index) const
+{
+    using detail::load;
+
+    auto begin = load<uint32_t>(order, offsets + size_t(index) * 4);
+    auto end = load<uint32_t>(order, offsets + size_t(index) * 4 + 4);
+    if (begin >= end || end > data.size()) {
+        throw LoaderError("Constant " + std::to_string(index) + " is out of the constant pool bounds");
+    }
+
+    const char* ptr = data.data() + begin;
+    auto payload_size = end - begin - 1;
+    switch (uint8_t(*ptr)) {
+        case integer_tag: {
+            if (payload_size != 8) {
+                break;
+            }
+            return Constant(std::in_place_type<int64_t>, int64_t(load<uint64_t>(order, ptr + 1)));
+        }
+        case float_tag: {
+            if (payload_size != 8) {
+                break;
+            }
+            auto bits = load<uint64_t>(order, ptr + 1);
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return Constant(std::in_place_type<double>, value);
+        }
+        case string_tag: {
+            return Constant(std::in_place_type<std::string>, ptr + 1, payload_size);
+        }
+        default: {
+            throw LoaderError("Unknown constant tag: " + std::to_string(uint8_t(*ptr)));
+        }
+    }
+    throw LoaderError("Invalid size of constant " + std::to_string(index));
+}
+
+
+std::string build_constant_pool(const std::vector<Constant>& constants, ByteOrder order)
+{
+    using detail::append;
+
+    std::string data;
+    std::vector<uint64_t> offsets;
+    offsets.reserve(constants.size() + 1);
+    for (const auto& constant : constants) {
+        offsets.push_back(data.size());
+        if (auto integer = std::get_if<int64_t>(&constant)) {
+            data.push_back(char(integer_tag));
+            append<uint64_t>(order, data, uint64_t(*integer));
+        } else if (auto number = std::get_if<double>(&constant)) {
+            uint64_t bits;
+            std::memcpy(&bits, number, sizeof(bits));
+            data.push_back(char(float_tag));
+            append<uint64_t>(order, data, bits);
+        } else {
+            data.push_back(char(string_tag));
+            data += std::get<std::string>(constant);
+        }
+    }
+    offsets.push_back(data.size());
+
+    if (constants.size() >= 0xFFFFFFFFu || data.size() > 0xFFFFFFFFu) {
+        throw LoaderError("Constants do not fit into a constant pool");
+    }
+
+    std::string out;
+    out.reserve(4 + offsets.size() * 4 + data.size());
+    append<uint32_t>(order, out, uint32_t(constants.size()));
+    for (auto offset : offsets) {
+        append<uint32_t>(order, out, uint32_t(offset));
+    }
+    out += data;
+    return out;
+}
+
+}
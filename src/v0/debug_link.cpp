@@ -0,0 +1,102 @@
+#include <pex_loader/debug_info.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+#include <pex_loader/relocations.hpp>
+#include <pex_loader/section_store.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+
+namespace pex::loader::v0
+{
+
+DebugLink read_debug_link(std::string_view section_data, ByteOrder order)
+{
+    using detail::load;
+
+    if (section_data.size() < 12) {
+        throw LoaderError("Unexpected EOF while reading debug link");
+    }
+    auto checksum = load<uint64_t>(order, section_data.data());
+    auto path_size = load<uint32_t>(order, section_data.data() + 8);
+    if (path_size != section_data.size() - 12) {
+        throw LoaderError("Invalid debug link path size: " + std::to_string(path_size));
+    }
+    return DebugLink{section_data.substr(12), checksum};
+}
+
+
+std::string write_debug_link(const DebugLink& link, ByteOrder order)
+{
+    using detail::append;
+
+    if (link.path.size() > 0xFFFFFFFFu) {
+        throw LoaderError("Debug link path is too long");
+    }
+    std::string out;
+    append<uint64_t>(order, out, link.checksum);
+    append<uint32_t>(order, out, uint32_t(link.path.size()));
+    out += link.path;
+    return out;
+}
+
+
+SplitSections split_debug_sections(
+    const std::string_view& data,
+    const std::vector<std::array<char, 4>>& debug_section_names,
+    const std::string& debug_path
+)
+{
+    auto sections = read_sections(data);
+    if (sections.size() > 0xFFFFFFFFu) {
+        throw LoaderError("Too many sections to split");
+    }
+    std::vector<bool> is_debug(sections.size());
+    std::vector<uint32_t> new_indices(sections.size());
+    uint32_t main_count = 0;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        if (sections[i].name == debug_link_section_name) {
+            throw LoaderError("Debug sections are already split");
+        }
+        is_debug[i] = std::find(debug_section_names.begin(), debug_section_names.end(), sections[i].name)
+            != debug_section_names.end();
+        if (!is_debug[i]) {
+            new_indices[i] = main_count++;
+        }
+    }
+
+    std::vector<std::string> remapped;
+    remapped.reserve(sections.size());
+    std::vector<SectionContents> main_sections;
+    std::vector<SectionContents> debug_sections;
+    for (size_t i = 0; i < sections.size(); ++i) {
+        auto contents = data.substr(sections[i].offset, sections[i].size);
+        if (is_debug[i]) {
+            debug_sections.push_back(SectionContents{sections[i].name, contents});
+            continue;
+        }
+        // Moving sections out shifts the indices of the following ones, which relocations refer to
+        if (sections[i].name == relocation_section_name) {
+            RelocationTable table(contents);
+            for (size_t j = 0; j < sections.size(); ++j) {
+                if (is_debug[j] && table.has_relocations(uint32_t(j))) {
+                    throw LoaderError("Debug section " + std::to_string(j) + " has relocations");
+                }
+            }
+            remapped.push_back(remap_relocation_table(contents, new_indices));
+            contents = remapped.back();
+        }
+        main_sections.push_back(SectionContents{sections[i].name, contents});
+    }
+
+    SplitSections split;
+    split.debug_sections = write_sections(debug_sections);
+    auto link = write_debug_link(DebugLink{debug_path, content_hash(split.debug_sections)});
+    main_sections.push_back(SectionContents{debug_link_section_name, link});
+    split.main_sections = write_sections(main_sections);
+    return split;
+}
+
+}
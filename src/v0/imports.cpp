@@ -0,0 +1,54 @@
+#include <pex_loader/dependencies.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+
+namespace pex::loader::v0
+{
+
+std::vector<std::string_view> read_imports(std::string_view section_data, ByteOrder order)
+{
+    using detail::load;
+
+    if (section_data.size() < 4) {
+        throw LoaderError("Unexpected EOF while reading import table header");
+    }
+    auto import_count = load<uint32_t>(order, section_data.data());
+
+    std::vector<std::string_view> imports;
+    // Every import takes at least 4 bytes, which bounds the reservation for malformed data
+    imports.reserve(std::min<uint64_t>(import_count, section_data.size() / 4));
+
+    size_t offset = 4;
+    for (uint32_t i = 0; i < import_count; ++i) {
+        if (section_data.size() - offset < 4) {
+            throw LoaderError("Unexpected EOF while reading import table");
+        }
+        auto name_size = load<uint32_t>(order, section_data.data() + offset);
+        offset += 4;
+        if (section_data.size() - offset < name_size) {
+            throw LoaderError("Import name is out of the import table bounds");
+        }
+        imports.push_back(section_data.substr(offset, name_size));
+        offset += name_size;
+    }
+
+    return imports;
+}
+
+
+std::string write_imports(const std::vector<std::string_view>& imports, ByteOrder order)
+{
+    std::string out;
+    detail::append<uint32_t>(order, out, uint32_t(imports.size()));
+    for (auto name : imports) {
+        detail::append<uint32_t>(order, out, uint32_t(name.size()));
+        out += name;
+    }
+    return out;
+}
+
+}
@@ -1,7 +1,8 @@
 #include <pex_loader/pex_loader.hpp>
 
-#include <libbinary_format/data_reader.hpp>
+#include <pex_loader/format.hpp>
 
+#include <algorithm>
 #include <cstdint>
 
 
@@ -10,23 +11,15 @@ namespace pex::loader::v0
 
 std::vector<Section> read_sections(const std::string_view& data)
 {
-    libbinary_format::DataReader r(data);
-    auto section_count = r.read_uint<uint64_t>();
-
     std::vector<Section> sections;
-    sections.reserve(section_count);
-
-    for (decltype(section_count) i = 0; i < section_count; ++i) {
-        Section section;
-        static_assert(section.name.size() == 4, "Section name length must be equal to 4");
-
-        section.size = r.read_uint<uint64_t>() - 4;
-        r.read_bytes(4, section.name.begin());
-        section.offset = r.get_offset();
+    // The count is validated by the walk itself, so do not trust it for the reservation
+    if (data.size() >= 8) {
+        sections.reserve(std::min<uint64_t>(libbinary_format::read_uint<uint64_t>(data), data.size() / 12));
+    }
 
+    for_each_section(data, [&sections](const Section& section) {
         sections.push_back(section);
-        r.skip(section.size);
-    }
+    });
 
     return sections;
 }
@@ -0,0 +1,297 @@
+#include <pex_loader/relocations.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+#include <pex_loader/detail/varint.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <tuple>
+
+
+namespace pex::loader::v0
+{
+
+namespace
+{
+
+constexpr uint64_t group_size = 20;
+constexpr size_t batch_size = 256;
+
+
+/// Decodes up to `batch_size` offsets, advancing `ptr`; returns the number of decoded ones
+size_t decode_batch(
+    const char*& ptr,
+    const char* end,
+    uint64_t& offset,
+    size_t remaining,
+    std::array<uint64_t, batch_size>& batch
+)
+{
+    auto n = std::min(remaining, batch_size);
+    detail::decode_uleb128(ptr, end, batch.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        if (__builtin_add_overflow(offset, batch[i], &offset)) {
+            throw LoaderError("Relocation offset is too large");
+        }
+        batch[i] = offset;
+    }
+    return n;
+}
+
+
+template <ByteOrder Order, typename T>
+void apply_batch(char* bytes, const uint64_t* offsets, size_t n, T displacement)
+{
+    // No branches here: bounds are checked for the whole batch by the caller
+    for (size_t i = 0; i < n; ++i) {
+        char* field = bytes + offsets[i];
+        detail::store<Order, T>(field, T(detail::load<Order, T>(field) + displacement));
+    }
+}
+
+
+template <ByteOrder Order>
+void apply_batch(RelocationType type, char* bytes, const uint64_t* offsets, size_t n, uint64_t displacement)
+{
+    switch (type) {
+        case RelocationType::add64: {
+            apply_batch<Order, uint64_t>(bytes, offsets, n, displacement);
+            break;
+        }
+        case RelocationType::add32: {
+            apply_batch<Order, uint32_t>(bytes, offsets, n, uint32_t(displacement));
+            break;
+        }
+    }
+}
+
+
+uint64_t field_size(RelocationType type)
+{
+    switch (type) {
+        case RelocationType::add64: {
+            return 8;
+        }
+        case RelocationType::add32: {
+            return 4;
+        }
+    }
+    throw LoaderError(
+        "Invalid or unsupported relocation type: " + std::to_string(static_cast<uint32_t>(type))
+    );
+}
+
+}
+
+
+RelocationTable::RelocationTable(std::string_view section_data, ByteOrder order):
+    order(order)
+{
+    using detail::load;
+
+    if (section_data.size() < 4) {
+        throw LoaderError("Unexpected EOF while reading relocation table header");
+    }
+    group_count = load<uint32_t>(order, section_data.data());
+    uint64_t data_offset = 4 + uint64_t(group_count) * group_size;
+    if (data_offset > section_data.size()) {
+        throw LoaderError("Unexpected EOF while reading relocation groups");
+    }
+    groups = section_data.data() + 4;
+    data = section_data.substr(data_offset);
+
+    for (uint32_t i = 0; i < group_count; ++i) {
+        const char* entry = groups + size_t(i) * group_size;
+        auto type = RelocationType(load<uint32_t>(order, entry + 4));
+        field_size(type);
+
+        auto offset = load<uint32_t>(order, entry + 12);
+        auto size = load<uint32_t>(order, entry + 16);
+        if (uint64_t(offset) + size > data.size()) {
+            throw LoaderError("Relocation group data is out of the section bounds");
+        }
+
+        if (i > 0) {
+            const char* prev = entry - group_size;
+            auto key = std::make_tuple(load<uint32_t>(order, entry), load<uint32_t>(order, entry + 4));
+            auto prev_key = std::make_tuple(load<uint32_t>(order, prev), load<uint32_t>(order, prev + 4));
+            if (!(prev_key < key)) {
+                throw LoaderError("Relocation groups are not sorted");
+            }
+        }
+    }
+}
+
+
+RelocationTable::Group RelocationTable::group(uint32_t index) const
+{
+    using detail::load;
+
+    const char* entry = groups + size_t(index) * group_size;
+    return Group{
+        load<uint32_t>(order, entry),
+        RelocationType(load<uint32_t>(order, entry + 4)),
+        load<uint32_t>(order, entry + 8),
+        data.substr(load<uint32_t>(order, entry + 12), load<uint32_t>(order, entry + 16)),
+    };
+}
+
+
+uint32_t RelocationTable::lower_bound(uint32_t section_index) const
+{
+    uint32_t lo = 0;
+    uint32_t hi = group_count;
+    while (lo < hi) {
+        auto mid = lo + (hi - lo) / 2;
+        if (detail::load<uint32_t>(order, groups + size_t(mid) * group_size) < section_index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+bool RelocationTable::has_relocations(uint32_t section_index) const
+{
+    auto i = lower_bound(section_index);
+    return i < group_count && group(i).section_index == section_index;
+}
+
+
+void RelocationTable::apply(
+    uint32_t section_index,
+    char* section_bytes,
+    uint64_t section_size,
+    uint64_t displacement
+) const
+{
+    std::array<uint64_t, batch_size> batch;
+
+    // Calls `visit(group, n)` for every batch of decoded offsets of the section's groups
+    auto for_each_batch = [&](auto&& visit) {
+        for (auto i = lower_bound(section_index); i < group_count; ++i) {
+            auto g = group(i);
+            if (g.section_index != section_index) {
+                break;
+            }
+            const char* ptr = g.data.data();
+            uint64_t offset = 0;
+            for (size_t remaining = g.count; remaining > 0;) {
+                auto n = decode_batch(ptr, g.data.data() + g.data.size(), offset, remaining, batch);
+                remaining -= n;
+                visit(g, n);
+            }
+        }
+    };
+
+    // Everything is validated before the first field is patched, so that a malformed table leaves
+    // the section untouched
+    for_each_batch([&](const Group& g, size_t n) {
+        // Offsets are non-decreasing, so checking the last one covers the whole batch
+        auto width = field_size(g.type);
+        if (section_size < width || batch[n - 1] > section_size - width) {
+            throw LoaderError("Relocation is out of the section bounds");
+        }
+    });
+
+    for_each_batch([&](const Group& g, size_t n) {
+        if (order == ByteOrder::little) {
+            apply_batch<ByteOrder::little>(g.type, section_bytes, batch.data(), n, displacement);
+        } else {
+            apply_batch<ByteOrder::big>(g.type, section_bytes, batch.data(), n, displacement);
+        }
+    });
+}
+
+
+std::string build_relocation_table(std::vector<Relocation> relocations, ByteOrder order)
+{
+    using detail::append;
+
+    std::sort(relocations.begin(), relocations.end(), [](const Relocation& lhs, const Relocation& rhs) {
+        return std::make_tuple(lhs.section_index, lhs.type, lhs.offset)
+            < std::make_tuple(rhs.section_index, rhs.type, rhs.offset);
+    });
+
+    std::string directory;
+    std::string data;
+    uint32_t group_count = 0;
+    for (size_t begin = 0; begin < relocations.size();) {
+        auto end = begin;
+        uint64_t prev_offset = 0;
+        auto data_offset = data.size();
+        while (
+            end < relocations.size()
+            && relocations[end].section_index == relocations[begin].section_index
+            && relocations[end].type == relocations[begin].type
+        ) {
+            detail::append_uleb128(data, relocations[end].offset - prev_offset);
+            prev_offset = relocations[end].offset;
+            ++end;
+        }
+        if (data.size() > 0xFFFFFFFFu || end - begin > 0xFFFFFFFFu) {
+            throw LoaderError("Relocations do not fit into a relocation table");
+        }
+
+        append<uint32_t>(order, directory, relocations[begin].section_index);
+        append<uint32_t>(order, directory, static_cast<uint32_t>(relocations[begin].type));
+        append<uint32_t>(order, directory, uint32_t(end - begin));
+        append<uint32_t>(order, directory, uint32_t(data_offset));
+        append<uint32_t>(order, directory, uint32_t(data.size() - data_offset));
+        ++group_count;
+        begin = end;
+    }
+
+    std::string out;
+    append<uint32_t>(order, out, group_count);
+    out += directory;
+    out += data;
+    return out;
+}
+
+
+std::string remap_relocation_table(
+    std::string_view section_data,
+    const std::vector<uint32_t>& new_indices,
+    ByteOrder order
+)
+{
+    using detail::load;
+
+    // Validates the directory
+    RelocationTable table(section_data, order);
+    auto group_count = load<uint32_t>(order, section_data.data());
+    std::vector<std::string_view> entries;
+    entries.reserve(group_count);
+    for (uint32_t i = 0; i < group_count; ++i) {
+        entries.push_back(section_data.substr(4 + size_t(i) * group_size, group_size));
+    }
+
+    auto new_key = [&new_indices, order](std::string_view entry) {
+        auto index = load<uint32_t>(order, entry.data());
+        if (index >= new_indices.size()) {
+            throw LoaderError("Relocation group targets a missing section: " + std::to_string(index));
+        }
+        return std::make_tuple(new_indices[index], load<uint32_t>(order, entry.data() + 4));
+    };
+    for (auto entry : entries) {
+        new_key(entry);
+    }
+    std::sort(entries.begin(), entries.end(), [&new_key](std::string_view lhs, std::string_view rhs) {
+        return new_key(lhs) < new_key(rhs);
+    });
+
+    // Group data is addressed by offset, so it is kept as is
+    std::string out(section_data.substr(0, 4));
+    for (auto entry : entries) {
+        detail::append<uint32_t>(order, out, std::get<0>(new_key(entry)));
+        out += entry.substr(4);
+    }
+    out += section_data.substr(4 + size_t(group_count) * group_size);
+    return out;
+}
+
+}
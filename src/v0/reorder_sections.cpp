@@ -0,0 +1,65 @@
+#include <pex_loader/pex_loader.hpp>
+#include <pex_loader/relocations.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace pex::loader::v0
+{
+
+std::string reorder_sections(const std::string_view& data, const std::vector<size_t>& hot_sections)
+{
+    auto sections = read_sections(data);
+
+    std::vector<bool> placed(sections.size(), false);
+    std::vector<size_t> order;
+    order.reserve(sections.size());
+
+    auto place = [&](size_t index) {
+        order.push_back(index);
+        placed[index] = true;
+    };
+
+    for (auto index : hot_sections) {
+        if (index >= sections.size()) {
+            throw LoaderError("Section index out of range: " + std::to_string(index));
+        }
+        if (!placed[index]) {
+            place(index);
+        }
+    }
+    for (size_t i = 0; i < sections.size(); ++i) {
+        if (!placed[i]) {
+            place(i);
+        }
+    }
+
+    if (sections.size() > 0xFFFFFFFFu) {
+        throw LoaderError("Too many sections to reorder");
+    }
+    std::vector<uint32_t> new_indices(sections.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        new_indices[order[i]] = uint32_t(i);
+    }
+
+    // Relocations refer to sections by index, so they have to follow the new order
+    std::vector<std::string> remapped;
+    remapped.reserve(sections.size());
+    std::vector<SectionContents> reordered;
+    reordered.reserve(sections.size());
+    for (auto index : order) {
+        const auto& section = sections[index];
+        auto contents = data.substr(section.offset, section.size);
+        if (section.name == relocation_section_name) {
+            remapped.push_back(remap_relocation_table(contents, new_indices));
+            contents = remapped.back();
+        }
+        reordered.push_back(SectionContents{section.name, contents});
+    }
+
+    return write_sections(reordered);
+}
+
+}
@@ -0,0 +1,94 @@
+#include <pex_loader/string_table.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <cstdint>
+
+
+namespace pex::loader::v0
+{
+
+namespace
+{
+
+constexpr uint64_t entry_size = 12;
+
+}
+
+
+StringTable::StringTable(std::string_view section_data, ByteOrder order):
+    order(order)
+{
+    if (section_data.size() < 4) {
+        throw LoaderError("Unexpected EOF while reading string table header");
+    }
+    string_count = detail::load<uint32_t>(order, section_data.data());
+
+    uint64_t data_offset = 4 + uint64_t(string_count) * entry_size;
+    if (data_offset > section_data.size()) {
+        throw LoaderError("Unexpected EOF while reading string table entries");
+    }
+    entries = section_data.data() + 4;
+    data = section_data.substr(data_offset);
+}
+
+
+std::string_view StringTable::operator[](uint32_t index) const
+{
+    using detail::load;
+
+    if (index >= string_count) {
+        throw LoaderError("String index out of range: " + std::to_string(index));
+    }
+    const char* entry = entries + size_t(index) * entry_size;
+    auto offset = load<uint32_t>(order, entry);
+    auto size = load<uint32_t>(order, entry + 4);
+    if (uint64_t(offset) + size > data.size()) {
+        throw LoaderError("String is out of the string table bounds");
+    }
+    return data.substr(offset, size);
+}
+
+
+uint32_t StringTable::hash(uint32_t index) const
+{
+    if (index >= string_count) {
+        throw LoaderError("String index out of range: " + std::to_string(index));
+    }
+    return detail::load<uint32_t>(order, entries + size_t(index) * entry_size + 8);
+}
+
+
+std::string_view StringTable::intern(uint32_t index, StringInterner& interner) const
+{
+    return interner.intern((*this)[index], hash(index));
+}
+
+
+std::string build_string_table(const std::vector<std::string_view>& strings, ByteOrder order)
+{
+    using detail::append;
+
+    if (strings.size() > 0xFFFFFFFFu) {
+        throw LoaderError("Too many strings for a string table");
+    }
+
+    std::string out;
+    append<uint32_t>(order, out, uint32_t(strings.size()));
+    uint64_t offset = 0;
+    for (auto str : strings) {
+        if (offset + str.size() > 0xFFFFFFFFu) {
+            throw LoaderError("Strings do not fit into a string table");
+        }
+        append<uint32_t>(order, out, uint32_t(offset));
+        append<uint32_t>(order, out, uint32_t(str.size()));
+        append<uint32_t>(order, out, name_hash(str));
+        offset += str.size();
+    }
+    for (auto str : strings) {
+        out += str;
+    }
+    return out;
+}
+
+}
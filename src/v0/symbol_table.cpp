@@ -0,0 +1,208 @@
+#include <pex_loader/symbol_table.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+
+namespace pex::loader::v0
+{
+
+namespace
+{
+
+constexpr uint32_t empty_bucket = 0xFFFFFFFFu;
+constexpr uint64_t header_size = 16;
+constexpr uint64_t entry_size = 16;
+constexpr uint32_t default_bloom_shift = 26;
+
+uint32_t bloom_word_count_for(size_t symbol_count)
+{
+    // About 16 filter bits per symbol, two of which are set
+    uint32_t words = 1;
+    while (uint64_t(words) * 4 < symbol_count) {
+        words *= 2;
+    }
+    return words;
+}
+
+}
+
+
+SymbolTable::SymbolTable(std::string_view section_data, ByteOrder order):
+    order(order)
+{
+    using detail::load;
+
+    if (section_data.size() < header_size) {
+        throw LoaderError("Unexpected EOF while reading symbol table header");
+    }
+    const char* ptr = section_data.data();
+    symbol_count = load<uint32_t>(order, ptr);
+    bucket_count = load<uint32_t>(order, ptr + 4);
+    auto bloom_word_count = load<uint32_t>(order, ptr + 8);
+    bloom_shift = load<uint32_t>(order, ptr + 12);
+
+    if (bloom_word_count == 0 || (bloom_word_count & (bloom_word_count - 1)) != 0) {
+        throw LoaderError("Symbol table bloom filter size must be a power of two");
+    }
+    if (bloom_shift >= 32) {
+        throw LoaderError("Invalid symbol table bloom shift: " + std::to_string(bloom_shift));
+    }
+    if (symbol_count != 0 && bucket_count == 0) {
+        throw LoaderError("Symbol table has symbols but no buckets");
+    }
+    bloom_mask = bloom_word_count - 1;
+
+    // All the sizes are 32-bit, so 64-bit arithmetic cannot overflow here
+    uint64_t bloom_offset = header_size;
+    uint64_t buckets_offset = bloom_offset + uint64_t(bloom_word_count) * 8;
+    uint64_t hashes_offset = buckets_offset + uint64_t(bucket_count) * 4;
+    uint64_t entries_offset = hashes_offset + uint64_t(symbol_count) * 4;
+    uint64_t names_offset = entries_offset + uint64_t(symbol_count) * entry_size;
+    if (names_offset > section_data.size()) {
+        throw LoaderError("Unexpected EOF while reading symbol table");
+    }
+
+    bloom = ptr + bloom_offset;
+    buckets = ptr + buckets_offset;
+    hashes = ptr + hashes_offset;
+    entries = ptr + entries_offset;
+    names = section_data.substr(names_offset);
+}
+
+
+bool SymbolTable::may_contain(uint32_t hash) const
+{
+    auto word = detail::load<uint64_t>(order, bloom + size_t((hash / 64) & bloom_mask) * 8);
+    uint64_t mask = (uint64_t(1) << (hash % 64)) | (uint64_t(1) << ((hash >> bloom_shift) % 64));
+    return (word & mask) == mask;
+}
+
+
+std::optional<Symbol> SymbolTable::lookup(std::string_view name) const
+{
+    return lookup(name, name_hash(name));
+}
+
+
+std::optional<Symbol> SymbolTable::lookup(std::string_view name, uint32_t hash) const
+{
+    using detail::load;
+
+    if (symbol_count == 0 || !may_contain(hash)) {
+        return std::nullopt;
+    }
+
+    auto index = load<uint32_t>(order, buckets + size_t(hash % bucket_count) * 4);
+    if (index == empty_bucket) {
+        return std::nullopt;
+    }
+
+    for (; index < symbol_count; ++index) {
+        auto chain_hash = load<uint32_t>(order, hashes + size_t(index) * 4);
+        if ((chain_hash | 1) == (hash | 1)) {
+            auto symbol = (*this)[index];
+            if (symbol.name == name) {
+                return symbol;
+            }
+        }
+        if (chain_hash & 1) {
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+
+Symbol SymbolTable::operator[](uint32_t index) const
+{
+    using detail::load;
+
+    if (index >= symbol_count) {
+        throw LoaderError("Symbol index out of range: " + std::to_string(index));
+    }
+    const char* entry = entries + size_t(index) * entry_size;
+    auto name_offset = load<uint32_t>(order, entry);
+    auto name_size = load<uint32_t>(order, entry + 4);
+    if (uint64_t(name_offset) + name_size > names.size()) {
+        throw LoaderError("Symbol name is out of the symbol table bounds");
+    }
+    return Symbol{names.substr(name_offset, name_size), load<uint64_t>(order, entry + 8)};
+}
+
+
+std::string build_symbol_table(const std::vector<std::pair<std::string, uint64_t>>& symbols, ByteOrder order)
+{
+    using detail::append;
+
+    if (symbols.size() >= empty_bucket) {
+        throw LoaderError("Too many symbols for a symbol table");
+    }
+
+    auto symbol_count = uint32_t(symbols.size());
+    auto bucket_count = std::max<uint32_t>(symbol_count, 1);
+    auto bloom_word_count = bloom_word_count_for(symbol_count);
+
+    struct Entry
+    {
+        uint32_t hash;
+        uint32_t bucket;
+        const std::pair<std::string, uint64_t>* symbol;
+    };
+    std::vector<Entry> sorted;
+    sorted.reserve(symbol_count);
+    for (const auto& symbol : symbols) {
+        auto hash = name_hash(symbol.first);
+        sorted.push_back(Entry{hash, hash % bucket_count, &symbol});
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Entry& lhs, const Entry& rhs) {
+        return lhs.bucket < rhs.bucket;
+    });
+
+    std::vector<uint64_t> bloom(bloom_word_count, 0);
+    std::vector<uint32_t> buckets(bucket_count, empty_bucket);
+    for (uint32_t i = 0; i < symbol_count; ++i) {
+        auto hash = sorted[i].hash;
+        bloom[(hash / 64) & (bloom_word_count - 1)] |=
+            (uint64_t(1) << (hash % 64)) | (uint64_t(1) << ((hash >> default_bloom_shift) % 64));
+        if (buckets[sorted[i].bucket] == empty_bucket) {
+            buckets[sorted[i].bucket] = i;
+        }
+    }
+
+    std::string out;
+    append<uint32_t>(order, out, symbol_count);
+    append<uint32_t>(order, out, bucket_count);
+    append<uint32_t>(order, out, bloom_word_count);
+    append<uint32_t>(order, out, default_bloom_shift);
+    for (auto word : bloom) {
+        append<uint64_t>(order, out, word);
+    }
+    for (auto bucket : buckets) {
+        append<uint32_t>(order, out, bucket);
+    }
+    for (uint32_t i = 0; i < symbol_count; ++i) {
+        bool last_in_chain = (i + 1 == symbol_count || sorted[i + 1].bucket != sorted[i].bucket);
+        append<uint32_t>(order, out, (sorted[i].hash & ~1u) | (last_in_chain ? 1u : 0u));
+    }
+
+    uint64_t name_offset = 0;
+    for (const auto& entry : sorted) {
+        const auto& name = entry.symbol->first;
+        if (name_offset + name.size() > 0xFFFFFFFFu) {
+            throw LoaderError("Symbol names do not fit into a symbol table");
+        }
+        append<uint32_t>(order, out, uint32_t(name_offset));
+        append<uint32_t>(order, out, uint32_t(name.size()));
+        append<uint64_t>(order, out, entry.symbol->second);
+        name_offset += name.size();
+    }
+    for (const auto& entry : sorted) {
+        out += entry.symbol->first;
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,32 @@
+#include <pex_loader/pex_loader.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <cstdint>
+
+
+namespace pex::loader::v0
+{
+
+std::string write_sections(const std::vector<SectionContents>& sections)
+{
+    using detail::append_be;
+
+    size_t total_size = 8;
+    for (const auto& section : sections) {
+        total_size += 12 + section.data.size();
+    }
+
+    std::string out;
+    out.reserve(total_size);
+    append_be<uint64_t>(out, sections.size());
+    for (const auto& section : sections) {
+        // The encoded size includes the section name
+        append_be<uint64_t>(out, uint64_t(section.data.size()) + 4);
+        out.append(section.name.begin(), section.name.end());
+        out += section.data;
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,36 @@
+#include <pex_loader/pex_loader.hpp>
+
+#include <pex_loader/format.hpp>
+
+#include <cstdint>
+
+
+namespace pex::loader::v1
+{
+
+uint32_t read_feature_flags(const std::string_view& data)
+{
+    if (data.size() < 4) {
+        throw LoaderError("Unexpected EOF while reading feature flags");
+    }
+    auto flags = detail::load_be<uint32_t>(data.data());
+    if ((flags & ~supported_feature_flags) != 0) {
+        throw LoaderError("Unsupported feature flags: " + std::to_string(flags & ~supported_feature_flags));
+    }
+    if ((flags & compact_table) && (flags & footer_table)) {
+        throw LoaderError("Compact and footer section tables cannot be combined");
+    }
+    return flags;
+}
+
+
+std::vector<Section> read_sections(const std::string_view& data)
+{
+    std::vector<Section> sections;
+    for_each_section(data, [&sections](const Section& section) {
+        sections.push_back(section);
+    });
+    return sections;
+}
+
+}
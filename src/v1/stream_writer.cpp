@@ -0,0 +1,109 @@
+#include <pex_loader/stream_writer.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+#include <string>
+
+
+namespace pex::loader::v1
+{
+
+namespace
+{
+
+template <ByteOrder Order, typename Entries>
+std::string encode_table(const Entries& entries, uint64_t table_offset)
+{
+    std::string out;
+    for (const auto& entry : entries) {
+        detail::append<Order, uint64_t>(out, entry.offset);
+        detail::append<Order, uint64_t>(out, entry.size);
+        out.append(entry.name.begin(), entry.name.end());
+    }
+    detail::append<Order, uint64_t>(out, table_offset);
+    detail::append<Order, uint64_t>(out, entries.size());
+    out += "PEXF";
+    return out;
+}
+
+}
+
+
+SectionStreamWriter::SectionStreamWriter(std::ostream& out, uint32_t feature_flags):
+    out(out),
+    flags(feature_flags | footer_table),
+    offset(0),
+    in_section(false),
+    finished(false)
+{
+    if ((flags & ~supported_feature_flags) != 0 || (flags & compact_table)) {
+        throw LoaderError("Unsupported feature flags for a streamed section table: " + std::to_string(flags));
+    }
+    std::string encoded_flags;
+    detail::append_be<uint32_t>(encoded_flags, flags);
+    write(encoded_flags);
+}
+
+
+void SectionStreamWriter::write(std::string_view data)
+{
+    out.write(data.data(), std::streamsize(data.size()));
+    if (!out) {
+        throw LoaderError("Unable to write section data");
+    }
+    offset += data.size();
+}
+
+
+void SectionStreamWriter::add_section(const std::array<char, 4>& name, std::string_view data)
+{
+    begin_section(name);
+    append(data);
+    end_section();
+}
+
+
+void SectionStreamWriter::begin_section(const std::array<char, 4>& name)
+{
+    if (in_section || finished) {
+        throw LoaderError("Cannot begin a section here");
+    }
+    entries.push_back(Entry{offset, 0, name});
+    in_section = true;
+}
+
+
+void SectionStreamWriter::append(std::string_view data)
+{
+    if (!in_section) {
+        throw LoaderError("Cannot append data outside of a section");
+    }
+    write(data);
+    entries.back().size += data.size();
+}
+
+
+void SectionStreamWriter::end_section()
+{
+    if (!in_section) {
+        throw LoaderError("Cannot end a section which has not begun");
+    }
+    in_section = false;
+}
+
+
+void SectionStreamWriter::finish()
+{
+    if (in_section || finished) {
+        throw LoaderError("Cannot finish the section table here");
+    }
+    auto table_offset = offset;
+    if (byte_order(flags) == ByteOrder::little) {
+        write(encode_table<ByteOrder::little>(entries, table_offset));
+    } else {
+        write(encode_table<ByteOrder::big>(entries, table_offset));
+    }
+    finished = true;
+}
+
+}
@@ -0,0 +1,87 @@
+#include <pex_loader/pex_loader.hpp>
+
+#include <pex_loader/stream_writer.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+#include <pex_loader/detail/varint.hpp>
+
+#include <cstdint>
+#include <map>
+#include <sstream>
+
+
+namespace pex::loader::v1
+{
+
+namespace
+{
+
+template <ByteOrder Order>
+void write_table(std::string& out, const std::vector<SectionContents>& sections)
+{
+    detail::append<Order, uint64_t>(out, sections.size());
+    for (const auto& section : sections) {
+        // The encoded size includes the section name
+        detail::append<Order, uint64_t>(out, uint64_t(section.data.size()) + 4);
+        out.append(section.name.begin(), section.name.end());
+        out += section.data;
+    }
+}
+
+
+void write_compact_table(std::string& out, const std::vector<SectionContents>& sections)
+{
+    std::map<std::array<char, 4>, uint64_t> name_indices;
+    std::vector<std::array<char, 4>> names;
+    for (const auto& section : sections) {
+        if (name_indices.emplace(section.name, names.size()).second) {
+            names.push_back(section.name);
+        }
+    }
+
+    detail::append_uleb128(out, sections.size());
+    detail::append_uleb128(out, names.size());
+    for (const auto& name : names) {
+        out.append(name.begin(), name.end());
+    }
+    for (const auto& section : sections) {
+        detail::append_uleb128(out, name_indices.at(section.name));
+        detail::append_uleb128(out, section.data.size());
+    }
+    for (const auto& section : sections) {
+        out += section.data;
+    }
+}
+
+}
+
+
+std::string write_sections(uint32_t feature_flags, const std::vector<SectionContents>& sections)
+{
+    if ((feature_flags & ~supported_feature_flags) != 0) {
+        throw LoaderError("Unsupported feature flags: " + std::to_string(feature_flags & ~supported_feature_flags));
+    }
+
+    if (feature_flags & footer_table) {
+        std::ostringstream stream;
+        SectionStreamWriter writer(stream, feature_flags);
+        for (const auto& section : sections) {
+            writer.add_section(section.name, section.data);
+        }
+        writer.finish();
+        return stream.str();
+    }
+
+    std::string out;
+    detail::append_be<uint32_t>(out, feature_flags);
+    if (feature_flags & compact_table) {
+        write_compact_table(out, sections);
+    } else if (byte_order(feature_flags) == ByteOrder::little) {
+        write_table<ByteOrder::little>(out, sections);
+    } else {
+        write_table<ByteOrder::big>(out, sections);
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,18 @@
+#include <pex_loader/pex_loader.hpp>
+
+#include <pex_loader/detail/byte_order.hpp>
+
+
+namespace pex::loader
+{
+
+std::string write_early_header(const EarlyHeaderInfo& info)
+{
+    std::string out = "PEX";
+    out.push_back(char(static_cast<uint8_t>(info.file_type)));
+    detail::append_be<uint16_t>(out, info.format_version.major);
+    detail::append_be<uint16_t>(out, info.format_version.minor);
+    return out;
+}
+
+}
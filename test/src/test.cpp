@@ -5,6 +5,7 @@
 #include <pex_loader/pex_loader.hpp>
 
 #include <list>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -139,4 +140,46 @@ TEST_CASE("v0::read_sections is working", "[read_sections]") {
 
         REQUIRE_THROWS(v0::read_sections(blob));
     }
+    SECTION("encoded size smaller than the name") {
+        for (char encoded_size = 0; encoded_size < 4; ++encoded_size) {
+            auto blob = (
+                "\x00\x00\x00\x00\x00\x00\x00\x01"
+                "\x00\x00\x00\x00\x00\x00\x00"s + encoded_size
+                + "name"
+                // Enough bytes follow, so the size must not wrap around and pass as valid
+                + std::string(64, 'x')
+            );
+            REQUIRE_THROWS_AS(v0::read_sections(blob), LoaderError);
+            REQUIRE_THROWS_WITH(v0::read_sections(blob), Catch::Contains("invalid encoded size"));
+        }
+    }
+    SECTION("size overflowing the offset") {
+        auto blob = (
+            "\x00\x00\x00\x00\x00\x00\x00\x01"
+            "\xff\xff\xff\xff\xff\xff\xff\xff"
+            "name"
+            "data"
+            ""sv
+        );
+        REQUIRE_THROWS_WITH(v0::read_sections(blob), Catch::Contains("overflows"));
+    }
+    SECTION("truncated section header") {
+        auto blob = (
+            "\x00\x00\x00\x00\x00\x00\x00\x01"
+            "\x00\x00\x00\x00\x00\x00\x00\x04"
+            "nam"
+            ""sv
+        );
+        REQUIRE_THROWS_WITH(v0::read_sections(blob), Catch::Contains("header of section 0"));
+    }
+    SECTION("data past the end") {
+        auto blob = (
+            "\x00\x00\x00\x00\x00\x00\x00\x01"
+            "\x00\x00\x00\x00\x00\x00\x00\x09"
+            "name"
+            "data"
+            ""sv
+        );
+        REQUIRE_THROWS_WITH(v0::read_sections(blob), Catch::Contains("data of section 0"));
+    }
 }
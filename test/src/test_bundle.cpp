@@ -0,0 +1,63 @@
+#include <catch.hpp>
+
+#include <pex_loader/bundle.hpp>
+
+#include "test_utils.hpp"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("Bundle is working", "[bundle]") {
+    using namespace pex::loader;
+
+    auto make_module = [](std::string_view code) {
+        return write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+            + v0::write_sections({{v0::section_name("CODE"), code}});
+    };
+    auto os = make_module("os code");
+    auto sys = make_module("sys code");
+    auto math = make_module("math code");
+
+    SECTION("load modules") {
+        auto path = write_temp_file(write_bundle({{"sys"sv, sys}, {"os"sv, os}, {"math"sv, math}}));
+        Bundle bundle(path);
+        REQUIRE(bundle.size() == 3);
+        CHECK(bundle.module_name(0) == "math");
+        CHECK(bundle.module_name(2) == "sys");
+
+        CHECK(bundle.find("os") == std::string_view(os));
+        CHECK_FALSE(bundle.find("o"));
+        CHECK_FALSE(bundle.find("zzz"));
+
+        auto module = bundle.load("sys");
+        REQUIRE(module->sections().size() == 1);
+        CHECK(module->section_data(module->sections()[0]) == "sys code");
+        CHECK(reinterpret_cast<uintptr_t>(module->data().data()) % 4096 == 0);
+        CHECK_NOTHROW(module->prefetch(module->sections()[0]));
+
+        REQUIRE_THROWS_AS(bundle.load("json"), LoaderError);
+        std::remove(path.c_str());
+    }
+    SECTION("duplicate names") {
+        REQUIRE_THROWS_AS(write_bundle({{"os"sv, os}, {"os"sv, sys}}), LoaderError);
+    }
+    SECTION("corrupted index") {
+        auto blob = write_bundle({{"os"sv, os}});
+        blob[24] = '\xFF';
+        auto path = write_temp_file(blob);
+        REQUIRE_THROWS_AS(Bundle(path), LoaderError);
+        std::remove(path.c_str());
+    }
+    SECTION("invalid magic") {
+        auto path = write_temp_file("PEXA\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"sv);
+        REQUIRE_THROWS_AS(Bundle(path), LoaderError);
+        std::remove(path.c_str());
+    }
+}
@@ -0,0 +1,92 @@
+#include <catch.hpp>
+
+#include <pex_loader/constant_pool.hpp>
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("Constant pool is working", "[constant_pool]") {
+    using namespace pex::loader;
+    using v0::Constant;
+
+    SECTION("lazy decoding") {
+        auto blob = v0::build_constant_pool({
+            Constant(int64_t(-42)),
+            Constant(2.5),
+            Constant("hello"s),
+            Constant(""s),
+        });
+        v0::ConstantPool pool(blob);
+        REQUIRE(pool.size() == 4);
+        CHECK(pool.decoded_count() == 0);
+
+        CHECK(std::get<std::string>(pool[2]) == "hello");
+        CHECK(pool.decoded_count() == 1);
+        CHECK(&pool[2] == &pool[2]);
+        CHECK(std::get<int64_t>(pool[0]) == -42);
+        CHECK(std::get<double>(pool[1]) == 2.5);
+        CHECK(std::get<std::string>(pool[3]).empty());
+        CHECK(pool.decoded_count() == 4);
+        REQUIRE_THROWS_AS(pool[4], LoaderError);
+
+        auto little = v0::build_constant_pool({Constant(int64_t(-42)), Constant(2.5)}, ByteOrder::little);
+        CHECK(little.substr(0, 4) == "\x02\x00\x00\x00"sv);
+        v0::ConstantPool little_pool(little, ByteOrder::little);
+        CHECK(std::get<int64_t>(little_pool[0]) == -42);
+        CHECK(std::get<double>(little_pool[1]) == 2.5);
+    }
+    SECTION("concurrent access") {
+        std::vector<Constant> constants;
+        for (int64_t i = 0; i < 1000; ++i) {
+            constants.emplace_back(i % 2 == 0 ? Constant(i) : Constant(std::to_string(i)));
+        }
+        auto blob = v0::build_constant_pool(constants);
+        v0::ConstantPool pool(blob);
+
+        std::atomic<bool> ok{true};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&pool, &constants, &ok]() {
+                for (uint32_t i = 0; i < pool.size(); ++i) {
+                    if (pool[i] != constants[i]) {
+                        ok = false;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        CHECK(ok);
+        CHECK(pool.decoded_count() == 1000);
+    }
+    SECTION("malformed pool") {
+        REQUIRE_THROWS_AS(v0::ConstantPool("\x00\x00"sv), LoaderError);
+        REQUIRE_THROWS_AS(v0::ConstantPool("\x00\x00\x00\x02\x00\x00\x00\x00"sv), LoaderError);
+
+        // An invalid constant only fails when it is accessed
+        auto blob = (
+            "\x00\x00\x00\x03"
+            "\x00\x00\x00\x00"
+            "\x00\x00\x00\x02"
+            "\x00\x00\x00\x04"
+            "\x00\x00\x00\x09"
+            "\x00" "a"
+            "\x07" "b"
+            "\x02" "abcd"
+            ""sv
+        );
+        v0::ConstantPool pool(blob);
+        REQUIRE_THROWS_AS(pool[0], LoaderError);
+        REQUIRE_THROWS_AS(pool[1], LoaderError);
+        CHECK(std::get<std::string>(pool[2]) == "abcd");
+        CHECK(pool.decoded_count() == 1);
+    }
+}
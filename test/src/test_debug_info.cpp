@@ -0,0 +1,124 @@
+#include <catch.hpp>
+
+#include <pex_loader/debug_info.hpp>
+#include <pex_loader/relocations.hpp>
+
+#include "test_utils.hpp"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("Split debug info is working", "[debug_info]") {
+    using namespace pex::loader;
+
+    auto header = write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}});
+    auto body = v0::write_sections({
+        {v0::section_name("CODE"), "code"sv},
+        {v0::section_name("LINE"), "line numbers"sv},
+        {v0::section_name("DATA"), "data"sv},
+    });
+
+    SECTION("debug link") {
+        auto blob = v0::write_debug_link({"module.debug", 0x0102030405060708});
+        auto link = v0::read_debug_link(blob);
+        CHECK(link.path == "module.debug");
+        CHECK(link.checksum == 0x0102030405060708);
+        REQUIRE_THROWS_AS(v0::read_debug_link(blob.substr(0, 11)), LoaderError);
+        REQUIRE_THROWS_AS(v0::read_debug_link(blob + "x"), LoaderError);
+
+        auto little = v0::write_debug_link({"module.debug", 0x0102030405060708}, ByteOrder::little);
+        CHECK(little.substr(0, 8) == "\x08\x07\x06\x05\x04\x03\x02\x01"sv);
+        CHECK(v0::read_debug_link(little, ByteOrder::little).checksum == 0x0102030405060708);
+    }
+    SECTION("inline debug sections") {
+        auto path = write_temp_file(header + body);
+        MappedFile file(path);
+        DebugInfo debug_info(file);
+        CHECK_FALSE(debug_info.has_debug_link());
+        CHECK(debug_info.section_data(v0::section_name("LINE")) == "line numbers");
+        CHECK(debug_info.section_data(v0::section_name("NONE")).empty());
+        std::remove(path.c_str());
+    }
+    SECTION("companion file") {
+        auto debug_path = write_temp_file("");
+        auto debug_name = debug_path.substr(debug_path.rfind('/') + 1);
+        auto split = v0::split_debug_sections(body, {v0::section_name("LINE")}, debug_name);
+
+        auto main_path = write_temp_file(header + split.main_sections);
+        MappedFile file(main_path);
+        REQUIRE(file.sections().size() == 3);
+        CHECK(file.find_section(v0::section_name("LINE")) == nullptr);
+        CHECK(file.section_data(file.sections()[1]) == "data");
+
+        DebugInfo debug_info(file);
+        CHECK(debug_info.has_debug_link());
+        CHECK(debug_info.companion_path() == debug_path);
+        CHECK(debug_info.section_data(v0::section_name("CODE")) == "code");
+
+        // The companion file is not opened until it is needed
+        REQUIRE_THROWS_AS(debug_info.section_data(v0::section_name("LINE")), LoaderError);
+        {
+            std::FILE* out = std::fopen(debug_path.c_str(), "wb");
+            auto contents = header + split.debug_sections;
+            std::fwrite(contents.data(), 1, contents.size(), out);
+            std::fclose(out);
+        }
+        CHECK(debug_info.section_data(v0::section_name("LINE")) == "line numbers");
+        CHECK(debug_info.section_data(v0::section_name("NONE")).empty());
+
+        // A companion file of another build is rejected
+        auto other = v0::split_debug_sections(
+            v0::write_sections({{v0::section_name("LINE"), "other"sv}}),
+            {v0::section_name("LINE")},
+            debug_name
+        );
+        {
+            std::FILE* out = std::fopen(debug_path.c_str(), "wb");
+            auto contents = header + other.debug_sections;
+            std::fwrite(contents.data(), 1, contents.size(), out);
+            std::fclose(out);
+        }
+        DebugInfo stale(file);
+        REQUIRE_THROWS_AS(stale.section_data(v0::section_name("LINE")), LoaderError);
+
+        REQUIRE_THROWS_AS(
+            v0::split_debug_sections(split.main_sections, {v0::section_name("LINE")}, debug_name),
+            LoaderError
+        );
+        std::remove(main_path.c_str());
+        std::remove(debug_path.c_str());
+    }
+    SECTION("relocated module") {
+        auto relocated = v0::write_sections({
+            {v0::section_name("CODE"), "\x00\x00\x00\x01"sv},
+            {v0::section_name("LINE"), "line numbers"sv},
+            {v0::section_name("DATA"), "\x00\x00\x00\x02"sv},
+            {v0::relocation_section_name, v0::build_relocation_table({
+                {0, v0::RelocationType::add32, 0},
+                {2, v0::RelocationType::add32, 0},
+            })},
+        });
+        auto split = v0::split_debug_sections(relocated, {v0::section_name("LINE")}, "module.debug");
+        auto sections = v0::read_sections(split.main_sections);
+        REQUIRE(sections.size() == 4);
+        REQUIRE(sections[2].name == v0::relocation_section_name);
+
+        auto main = split.main_sections;
+        v0::RelocationTable table(std::string_view(main).substr(sections[2].offset, sections[2].size));
+        CHECK_FALSE(table.has_relocations(2));
+        table.apply(1, main.data() + sections[1].offset, sections[1].size, 0x10);
+        CHECK(main.substr(sections[1].offset, sections[1].size) == "\x00\x00\x00\x12"sv);
+        table.apply(0, main.data() + sections[0].offset, sections[0].size, 0x10);
+        CHECK(main.substr(sections[0].offset, sections[0].size) == "\x00\x00\x00\x11"sv);
+
+        REQUIRE_THROWS_AS(
+            v0::split_debug_sections(relocated, {v0::section_name("DATA")}, "module.debug"),
+            LoaderError
+        );
+    }
+}
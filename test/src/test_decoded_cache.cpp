@@ -0,0 +1,169 @@
+#include <catch.hpp>
+
+#include <pex_loader/bundle.hpp>
+#include <pex_loader/decoded_cache.hpp>
+
+#include "test_utils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("Decoded section cache is working", "[decoded_cache]") {
+    using namespace pex::loader;
+
+    auto make_file = [](std::string_view first_code) {
+        return write_temp_file(
+            write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+            + v0::write_sections({
+                {v0::section_name("CODE"), first_code},
+                {v0::section_name("DATA"), "data"sv},
+                {v0::section_name("CODE"), "second"sv},
+            })
+        );
+    };
+    auto path = make_file("first");
+    auto sidecar_path = path + ".decoded";
+
+    size_t decode_calls = 0;
+    SectionDecoder decoder{v0::section_name("CODE"), 1, [&decode_calls](std::string_view data) {
+        ++decode_calls;
+        std::string decoded(data.rbegin(), data.rend());
+        return decoded;
+    }};
+
+    SECTION("sidecar") {
+        MappedFile file(path);
+        {
+            DecodedSections decoded(file, decoder);
+            CHECK(decoded.decoded_count() == 2);
+            CHECK(decoded.decoded(file.sections()[0]) == "tsrif");
+            CHECK(decoded.decoded(file.sections()[2]) == "dnoces");
+            REQUIRE_THROWS_AS(decoded.decoded(file.sections()[1]), LoaderError);
+        }
+        CHECK(decode_calls == 2);
+
+        DecodedSections cached(file, decoder);
+        CHECK(cached.decoded_count() == 0);
+        CHECK(decode_calls == 2);
+        auto first = cached.decoded(file.sections()[0]);
+        CHECK(first == "tsrif");
+        CHECK(reinterpret_cast<uintptr_t>(first.data()) % 16 == 0);
+        CHECK(cached.decoded(file.sections()[2]) == "dnoces");
+
+        // For the same file the digests are not even checked (only the location of the sections)
+        {
+            std::FILE* out = std::fopen(sidecar_path.c_str(), "r+b");
+            REQUIRE(out != nullptr);
+            std::fseek(out, 56 + 24, SEEK_SET);
+            std::fputs("\xff\xff\xff\xff", out);
+            std::fclose(out);
+        }
+        DecodedSections unhashed(file, decoder);
+        CHECK(unhashed.decoded_count() == 0);
+        CHECK(unhashed.decoded(file.sections()[0]) == "tsrif");
+
+        // Bumping the decoder version invalidates the sidecar
+        decoder.version = 2;
+        DecodedSections redecoded(file, decoder);
+        CHECK(redecoded.decoded_count() == 2);
+        CHECK(redecoded.decoded(file.sections()[2]) == "dnoces");
+    }
+    SECTION("changed sections") {
+        {
+            MappedFile file(path);
+            DecodedSections decoded(file, decoder, sidecar_path);
+        }
+        auto changed_path = make_file("changed");
+        MappedFile changed(changed_path);
+        DecodedSections decoded(changed, decoder, sidecar_path);
+        CHECK(decoded.decoded_count() == 1);
+        CHECK(decoded.decoded(changed.sections()[0]) == "degnahc");
+        CHECK(decoded.decoded(changed.sections()[2]) == "dnoces");
+
+        // Sections sharing their contents share their decoded data
+        auto twin_path = make_file("second");
+        MappedFile twin(twin_path);
+        DecodedSections twin_decoded(twin, decoder, sidecar_path);
+        CHECK(twin_decoded.decoded_count() == 0);
+        CHECK(twin_decoded.decoded(twin.sections()[0]).data() == twin_decoded.decoded(twin.sections()[2]).data());
+        std::remove(twin_path.c_str());
+        std::remove(changed_path.c_str());
+    }
+    SECTION("bundle members") {
+        auto make_module = [](std::string_view code) {
+            return write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+                + v0::write_sections({{v0::section_name("CODE"), code}});
+        };
+        auto bundle_path = write_temp_file(write_bundle({{"os"sv, make_module("os")}, {"sys"sv, make_module("sys")}}));
+        Bundle bundle(bundle_path);
+        auto os = bundle.load("os");
+        auto sys = bundle.load("sys");
+        CHECK(DecodedSections::default_sidecar_path(*os) != DecodedSections::default_sidecar_path(*sys));
+        {
+            DecodedSections decoded_os(*os, decoder);
+            DecodedSections decoded_sys(*sys, decoder);
+            CHECK(decoded_os.decoded(os->sections()[0]) == "so");
+            CHECK(decoded_sys.decoded(sys->sections()[0]) == "sys");
+        }
+
+        // Each member keeps its own sidecar up to date
+        DecodedSections cached_os(*os, decoder);
+        DecodedSections cached_sys(*sys, decoder);
+        CHECK(cached_os.decoded_count() == 0);
+        CHECK(cached_sys.decoded_count() == 0);
+        std::remove(DecodedSections::default_sidecar_path(*os).c_str());
+        std::remove(DecodedSections::default_sidecar_path(*sys).c_str());
+        std::remove(bundle_path.c_str());
+    }
+    SECTION("empty sections") {
+        // In a compact table an empty section shares its offset with the next one
+        auto compact_path = write_temp_file(
+            write_early_header({EarlyHeaderInfo::FileType::library, {1, 0}})
+            + v1::write_sections(v1::compact_table, {
+                {v0::section_name("DATA"), ""sv},
+                {v0::section_name("CODE"), ""sv},
+                {v0::section_name("CODE"), "code"sv},
+            })
+        );
+        MappedFile file(compact_path);
+        DecodedSections decoded(file, decoder, sidecar_path);
+        REQUIRE_THROWS_AS(decoded.decoded(file.sections()[0]), LoaderError);
+        CHECK(decoded.decoded(file.sections()[1]).empty());
+        CHECK(decoded.decoded(file.sections()[2]) == "edoc");
+        auto copy = file.sections()[2];
+        CHECK(decoded.decoded(copy) == "edoc");
+        std::remove(compact_path.c_str());
+    }
+    SECTION("unwritable sidecar") {
+        MappedFile file(path);
+        DecodedSections decoded(file, decoder, "/nonexistent/directory/sidecar");
+        CHECK(decoded.decoded_count() == 2);
+        CHECK(decoded.decoded(file.sections()[0]) == "tsrif");
+        CHECK(decoded.decoded(file.sections()[2]) == "dnoces");
+    }
+    SECTION("corrupted sidecar") {
+        MappedFile file(path);
+        {
+            DecodedSections decoded(file, decoder);
+        }
+        std::FILE* out = std::fopen(sidecar_path.c_str(), "r+b");
+        REQUIRE(out != nullptr);
+        // Data offset of the first entry
+        std::fseek(out, 56 + 56, SEEK_SET);
+        std::fputs("\xff\xff\xff\xff", out);
+        std::fclose(out);
+
+        DecodedSections decoded(file, decoder);
+        CHECK(decoded.decoded_count() == 2);
+        CHECK(decoded.decoded(file.sections()[0]) == "tsrif");
+    }
+
+    std::remove(sidecar_path.c_str());
+    std::remove(path.c_str());
+}
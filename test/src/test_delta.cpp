@@ -0,0 +1,102 @@
+#include <catch.hpp>
+
+#include <pex_loader/delta.hpp>
+#include <pex_loader/mapped_file.hpp>
+
+#include "test_utils.hpp"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("Deltas are working", "[delta]") {
+    using namespace pex::loader;
+
+    auto header = write_early_header({EarlyHeaderInfo::FileType::library, {0, 1}});
+    std::string big(10000, 'x');
+    auto old_data = header + v0::write_sections({
+        {v0::section_name("CODE"), big},
+        {v0::section_name("DATA"), "old data"sv},
+        {v0::section_name("DBUG"), "debug"sv},
+    });
+    auto new_data = header + v0::write_sections({
+        {v0::section_name("CODE"), big},
+        {v0::section_name("DATA"), "new data"sv},
+        {v0::section_name("DBUG"), "debug"sv},
+        {v0::section_name("XTRA"), "extra"sv},
+    });
+
+    auto delta = make_delta(old_data, new_data);
+    CHECK(delta.size() < 200);
+
+    auto old_path = write_temp_file(old_data);
+    auto new_path = old_path + ".new";
+    apply_delta(old_path, delta, new_path);
+    {
+        FileMapping result(new_path);
+        CHECK(result.data() == new_data);
+    }
+
+    SECTION("identical files") {
+        auto same = make_delta(old_data, old_data);
+        apply_delta(old_path, same, new_path);
+        FileMapping result(new_path);
+        CHECK(result.data() == old_data);
+    }
+    SECTION("in place") {
+        auto path = write_temp_file(old_data);
+        apply_delta(path, delta, path);
+        {
+            FileMapping result(path);
+            CHECK(result.data() == new_data);
+        }
+        // The base is gone now, so applying the delta again is rejected
+        REQUIRE_THROWS_AS(apply_delta(path, delta, path), LoaderError);
+        std::remove(path.c_str());
+    }
+    SECTION("wrong old file") {
+        auto other_path = write_temp_file(old_data + "?");
+        REQUIRE_THROWS_AS(apply_delta(other_path, delta, new_path), LoaderError);
+        std::remove(other_path.c_str());
+
+        // Same size, different contents in a copied section
+        auto modified = old_data;
+        modified.back() = '?';
+        auto modified_path = write_temp_file(modified);
+        REQUIRE_THROWS_AS(apply_delta(modified_path, delta, new_path), LoaderError);
+        std::remove(modified_path.c_str());
+    }
+    SECTION("changes outside the copied ranges") {
+        // The old DATA section is replaced by the delta, so its contents do not matter
+        auto modified = old_data;
+        auto data_offset = modified.find("old data");
+        REQUIRE(data_offset != std::string::npos);
+        modified[data_offset] = '?';
+        auto modified_path = write_temp_file(modified);
+        apply_delta(modified_path, delta, new_path);
+        FileMapping result(new_path);
+        CHECK(result.data() == new_data);
+        std::remove(modified_path.c_str());
+    }
+    SECTION("invalid delta") {
+        REQUIRE_THROWS_AS(apply_delta(old_path, "PEXX"sv, new_path), LoaderError);
+        REQUIRE_THROWS(apply_delta(old_path, std::string_view(delta).substr(0, delta.size() - 1), new_path));
+
+        // Announced new size (u64 after the magic, version and old size) smaller than the output of
+        // the first operation
+        auto short_output = delta;
+        short_output.replace(16, 8, "\x00\x00\x00\x00\x00\x00\x00\x01"sv);
+        REQUIRE_THROWS_AS(apply_delta(old_path, short_output, new_path), LoaderError);
+
+        // Failed applications leave the previous result alone
+        FileMapping result(new_path);
+        CHECK(result.data() == new_data);
+    }
+
+    std::remove(old_path.c_str());
+    std::remove(new_path.c_str());
+}
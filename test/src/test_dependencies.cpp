@@ -0,0 +1,122 @@
+#include <catch.hpp>
+
+#include <pex_loader/dependencies.hpp>
+
+#include "test_utils.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+namespace
+{
+
+std::string make_module(const std::vector<std::string_view>& imports)
+{
+    using namespace pex::loader;
+    auto import_table = v0::write_imports(imports);
+    return write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+        + v0::write_sections({
+            {v0::section_name("CODE"), "code"sv},
+            {v0::import_section_name, import_table},
+        });
+}
+
+}
+
+
+TEST_CASE("DependencyResolver is working", "[dependencies]") {
+    using namespace pex::loader;
+    SECTION("import table") {
+        auto blob = v0::write_imports({"os"sv, ""sv, "sys"sv});
+        auto imports = v0::read_imports(blob);
+        CHECK(imports == std::vector<std::string_view>{"os"sv, ""sv, "sys"sv});
+
+        // Truncated header, truncated entry, name past the end of the table
+        REQUIRE_THROWS_AS(v0::read_imports("\x00\x00"sv), LoaderError);
+        REQUIRE_THROWS_AS(v0::read_imports("\x00\x00\x00\x02\x00\x00\x00\x02os\x00\x00"sv), LoaderError);
+        REQUIRE_THROWS_AS(v0::read_imports("\x00\x00\x00\x01\x00\x00\x00\x05os"sv), LoaderError);
+
+        auto little = v0::write_imports({"os"sv, "sys"sv}, ByteOrder::little);
+        CHECK(little.substr(0, 8) == "\x02\x00\x00\x00\x02\x00\x00\x00"sv);
+        CHECK(v0::read_imports(little, ByteOrder::little) == std::vector<std::string_view>{"os"sv, "sys"sv});
+    }
+    SECTION("little-endian module") {
+        auto library_path = write_temp_file(make_module({}));
+        auto main_path = write_temp_file(
+            write_early_header({EarlyHeaderInfo::FileType::executable, {1, 0}})
+            + v1::write_sections(v1::little_endian, {
+                {v0::import_section_name, v0::write_imports({"lib"sv}, ByteOrder::little)},
+            })
+        );
+        DependencyResolver resolver([&library_path](const std::string&) {
+            return library_path;
+        });
+        auto modules = resolver.resolve("main", main_path);
+        REQUIRE(modules.size() == 2);
+        CHECK(modules.at("main").imports == std::vector<std::string>{"lib"});
+        std::remove(main_path.c_str());
+        std::remove(library_path.c_str());
+    }
+    SECTION("resolve") {
+        // main -> {a, b}, a -> {c}, b -> {c, a}, c -> {}
+        std::map<std::string, std::string> paths{
+            {"a", write_temp_file(make_module({"c"sv}))},
+            {"b", write_temp_file(make_module({"c"sv, "a"sv}))},
+            {"c", write_temp_file(make_module({}))},
+        };
+        auto main_path = write_temp_file(make_module({"a"sv, "b"sv}));
+
+        DependencyResolver resolver([&](const std::string& name) {
+            return paths.at(name);
+        }, LoadOptions{}, 4);
+        auto modules = resolver.resolve("main", main_path);
+
+        REQUIRE(modules.size() == 4);
+        CHECK(modules.at("main").imports == std::vector<std::string>{"a", "b"});
+        CHECK(modules.at("b").imports == std::vector<std::string>{"c", "a"});
+        CHECK(modules.at("c").imports.empty());
+        CHECK(modules.at("c").file->sections().size() == 2);
+
+        // Libraries imported by `a` are loaded while its sibling `slow` is still being located
+        std::mutex mutex;
+        std::condition_variable located;
+        bool c_located = false;
+        bool slow_waited = false;
+        auto slow_path = write_temp_file(make_module({}));
+        auto slow_main_path = write_temp_file(make_module({"slow"sv, "a"sv}));
+        DependencyResolver pipelined([&](const std::string& name) {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (name == "slow") {
+                slow_waited = located.wait_for(lock, std::chrono::seconds(5), [&]() { return c_located; });
+                return slow_path;
+            }
+            if (name == "c") {
+                c_located = true;
+                located.notify_all();
+            }
+            return paths.at(name);
+        }, LoadOptions{}, 2);
+        CHECK(pipelined.resolve("main", slow_main_path).size() == 4);
+        CHECK(slow_waited);
+        std::remove(slow_main_path.c_str());
+        std::remove(slow_path.c_str());
+
+        std::remove(paths.at("c").c_str());
+        REQUIRE_THROWS_AS(resolver.resolve("main", main_path), LoaderError);
+
+        std::remove(main_path.c_str());
+        for (const auto& [name, path] : paths) {
+            std::remove(path.c_str());
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#include <catch.hpp>
+
+#include <pex_loader/format.hpp>
+#include <pex_loader/stream_writer.hpp>
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("Format version dispatch is working", "[format]") {
+    using namespace pex::loader;
+    auto body = v0::write_sections({
+        {v0::section_name("AAAA"), "a"sv},
+        {v0::section_name("BBBB"), "bb"sv},
+    });
+
+    SECTION("visit") {
+        auto version = visit_format(0, [](auto parser) {
+            return parser.major_version;
+        });
+        CHECK(version == 0);
+
+        int calls = 0;
+        visit_format(0, [&calls](auto) {
+            ++calls;
+        });
+        CHECK(calls == 1);
+
+        REQUIRE_THROWS_AS(visit_format(7, [](auto parser) { return parser.major_version; }), LoaderError);
+    }
+    SECTION("for_each_section") {
+        std::vector<std::array<char, 4>> names;
+        FormatParser<0>::for_each_section(body, [&names](const v0::Section& section) {
+            names.push_back(section.name);
+        });
+        CHECK(names == std::vector<std::array<char, 4>>{v0::section_name("AAAA"), v0::section_name("BBBB")});
+    }
+    SECTION("v1 byte orders") {
+        for (uint32_t flags : {
+            0u,
+            uint32_t(v1::little_endian),
+            uint32_t(v1::compact_table),
+            uint32_t(v1::footer_table),
+            uint32_t(v1::footer_table | v1::little_endian),
+        }) {
+            auto v1_body = v1::write_sections(flags, {
+                {v0::section_name("AAAA"), "a"sv},
+                {v0::section_name("BBBB"), "bb"sv},
+            });
+            CHECK(v1::read_feature_flags(v1_body) == flags);
+            CHECK(FormatParser<1>::byte_order(v1_body) == v1::byte_order(flags));
+
+            auto sections = v1::read_sections(v1_body);
+            REQUIRE(sections.size() == 2);
+            CHECK(sections[0].name == v0::section_name("AAAA"));
+            CHECK(v1_body.substr(sections[1].offset, sections[1].size) == "bb");
+        }
+
+        auto little = v1::write_sections(v1::little_endian, {{v0::section_name("AAAA"), "a"sv}});
+        CHECK(little.substr(0, 12) == "\x00\x00\x00\x01\x01\x00\x00\x00\x00\x00\x00\x00"sv);
+        REQUIRE_THROWS_AS(v1::read_sections(little.substr(0, little.size() - 1)), LoaderError);
+        REQUIRE_THROWS_AS(v1::read_sections("\x00\x00\x80\x00"sv), LoaderError);
+    }
+    SECTION("v1 compact table") {
+        std::vector<std::string> contents;
+        std::vector<v1::SectionContents> sections;
+        for (size_t i = 0; i < 1000; ++i) {
+            contents.push_back(std::string(i % 300, char('a' + i % 26)));
+        }
+        for (size_t i = 0; i < contents.size(); ++i) {
+            sections.push_back({v0::section_name(i % 2 ? "CODE" : "DATA"), contents[i]});
+        }
+
+        auto compact = v1::write_sections(v1::compact_table, sections);
+        auto plain = v1::write_sections(0, sections);
+        CHECK(compact.size() < plain.size());
+
+        auto compact_sections = v1::read_sections(compact);
+        auto plain_sections = v1::read_sections(plain);
+        REQUIRE(compact_sections.size() == 1000);
+        for (size_t i = 0; i < 1000; ++i) {
+            CHECK(compact_sections[i].name == plain_sections[i].name);
+            CHECK(compact.substr(compact_sections[i].offset, compact_sections[i].size) == contents[i]);
+        }
+
+        // Header: flags, 1 section, 1 name, "NAME", name index 5 (out of range), size 0
+        REQUIRE_THROWS_AS(v1::read_sections("\x00\x00\x00\x02\x01\x01NAME\x05\x00"sv), LoaderError);
+        // Header: flags, 1 section, 1 name, "NAME", name index 0, size 3, 2 bytes of data
+        REQUIRE_THROWS_AS(v1::read_sections("\x00\x00\x00\x02\x01\x01NAME\x00\x03" "ab"sv), LoaderError);
+        CHECK(v1::read_sections("\x00\x00\x00\x02\x01\x01NAME\x00\x03" "abc"sv).size() == 1);
+        // Header: flags, 1024 sections, no names, room for a single entry
+        REQUIRE_THROWS_AS(v1::read_sections("\x00\x00\x00\x02\x80\x08\x00\x00\x00"sv), LoaderError);
+    }
+    SECTION("v1 streamed footer table") {
+        std::ostringstream stream;
+        v1::SectionStreamWriter writer(stream);
+        writer.add_section(v0::section_name("HEAD"), "head"sv);
+        writer.begin_section(v0::section_name("CODE"));
+        writer.append("co"sv);
+        writer.append("de"sv);
+        writer.end_section();
+        REQUIRE_THROWS_AS(writer.end_section(), LoaderError);
+        writer.finish();
+
+        auto blob = stream.str();
+        CHECK(v1::read_feature_flags(blob) == v1::footer_table);
+        auto sections = v1::read_sections(blob);
+        REQUIRE(sections.size() == 2);
+        CHECK(sections[0].offset == 4);
+        CHECK(blob.substr(sections[1].offset, sections[1].size) == "code");
+        CHECK(sections[1].name == v0::section_name("CODE"));
+
+        auto truncated = std::string_view(blob).substr(0, blob.size() - 1);
+        REQUIRE_THROWS_AS(v1::read_sections(truncated), LoaderError);
+        REQUIRE_THROWS_AS(v1::read_sections("\x00\x00\x00\x06"sv), LoaderError);
+
+        // Entries must be sorted by offset and must not overlap
+        auto table_offset = sections[1].offset + sections[1].size;
+        auto swapped = blob;
+        swapped.replace(table_offset, 20, blob, table_offset + 20, 20);
+        swapped.replace(table_offset + 20, 20, blob, table_offset, 20);
+        REQUIRE_THROWS_AS(v1::read_sections(swapped), LoaderError);
+        auto overlapping = blob;
+        overlapping[table_offset + 20 + 7] = char(sections[1].offset - 1);
+        REQUIRE_THROWS_AS(v1::read_sections(overlapping), LoaderError);
+    }
+    SECTION("read_file_sections") {
+        auto file = write_early_header({EarlyHeaderInfo::FileType::other, {0, 0}}) + body;
+        auto sections = read_file_sections(file);
+        REQUIRE(sections.size() == 2);
+        CHECK(sections[1].size == 2);
+
+        auto v1_file = write_early_header({EarlyHeaderInfo::FileType::other, {1, 0}})
+            + v1::write_sections(v1::little_endian, {{v0::section_name("AAAA"), "a"sv}});
+        REQUIRE(read_file_sections(v1_file).size() == 1);
+
+        auto future = write_early_header({EarlyHeaderInfo::FileType::other, {99, 0}}) + body;
+        REQUIRE_THROWS_AS(read_file_sections(future), LoaderError);
+    }
+}
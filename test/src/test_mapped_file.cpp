@@ -0,0 +1,243 @@
+#include <catch.hpp>
+
+#include <pex_loader/mapped_file.hpp>
+
+#include "test_utils.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("MappedFile is working", "[mapped_file]") {
+    using namespace pex::loader;
+    auto blob = (
+        "PEX\x01"
+        "\x00\x00\x00\x01"
+        "\x00\x00\x00\x00\x00\x00\x00\x02"
+
+        "\x00\x00\x00\x00\x00\x00\x00\x09"
+        "CODE"
+        "Hello"
+
+        "\x00\x00\x00\x00\x00\x00\x00\x07"
+        "DATA"
+        "abc"
+
+        ""sv
+    );
+    auto path = write_temp_file(blob);
+
+    SECTION("sections") {
+        MappedFile file(path);
+        CHECK(file.header().file_type == EarlyHeaderInfo::FileType::executable);
+        CHECK(file.byte_order() == ByteOrder::big);
+        REQUIRE(file.sections().size() == 2);
+        CHECK(file.section_data(file.sections()[0]) == "Hello");
+        CHECK(file.section_data(file.sections()[1]) == "abc");
+
+        auto data = file.find_section(v0::section_name("DATA"));
+        REQUIRE(data != nullptr);
+        CHECK(file.section_data(*data) == "abc");
+        CHECK(file.find_section(v0::section_name("NONE")) == nullptr);
+    }
+    SECTION("advice") {
+        LoadOptions options;
+        options.file_advice = AccessAdvice::random;
+        options.prefetch_sections = {v0::section_name("CODE")};
+        MappedFile file(path, options);
+
+        for (const auto& section : file.sections()) {
+            CHECK_NOTHROW(file.advise(section, AccessAdvice::sequential));
+            CHECK_NOTHROW(file.release(section));
+            CHECK_NOTHROW(file.prefetch(section));
+        }
+        CHECK(file.section_data(file.sections()[0]) == "Hello");
+    }
+    SECTION("huge pages") {
+        // Sections smaller than a huge page stay in the file mapping whatever the threshold
+        LoadOptions options;
+        options.huge_page_threshold = 4;
+        MappedFile small_file(path, options);
+        for (const auto& section : small_file.sections()) {
+            CHECK_FALSE(small_file.is_copied(section));
+        }
+        CHECK(small_file.section_data(small_file.sections()[0]) == "Hello");
+
+        std::string large(huge_page_size + 100, 'x');
+        auto large_path = write_temp_file(
+            write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+            + v0::write_sections({
+                {v0::section_name("CODE"), large},
+                {v0::section_name("DATA"), "abc"sv},
+            })
+        );
+        MappedFile file(large_path, options);
+        CHECK(reinterpret_cast<uintptr_t>(file.data().data()) % huge_page_size == 0);
+
+        const auto& code = file.sections()[0];
+        REQUIRE(file.is_copied(code));
+        auto data = file.section_data(code);
+        CHECK(data == large);
+        CHECK(reinterpret_cast<uintptr_t>(data.data()) % huge_page_size == 0);
+        CHECK(file.huge_page_bytes(code) <= code.size);
+        CHECK_NOTHROW(file.release(code));
+        CHECK(file.section_data(code) == large);
+
+        const auto& small = file.sections()[1];
+        CHECK_FALSE(file.is_copied(small));
+        CHECK(file.section_data(small).data() == file.data().data() + 8 + small.offset);
+
+        // Aligned placements do not leak the padding of their reservations (the file and the copy
+        // are not page multiples)
+        auto mapped_bytes = []() {
+            std::ifstream maps("/proc/self/maps");
+            uint64_t total = 0;
+            std::string line;
+            while (std::getline(maps, line)) {
+                auto dash = line.find('-');
+                auto space = line.find(' ');
+                total += std::stoull(line.substr(dash + 1, space - dash - 1), nullptr, 16)
+                    - std::stoull(line.substr(0, dash), nullptr, 16);
+            }
+            return total;
+        };
+        auto before = mapped_bytes();
+        for (int i = 0; i < 20; ++i) {
+            MappedFile reloaded(large_path, options);
+        }
+        CHECK(mapped_bytes() < before + huge_page_size);
+        std::remove(large_path.c_str());
+    }
+    SECTION("access trace") {
+        LoadOptions options;
+        options.trace_access = true;
+        options.prefetch_sections = {v0::section_name("CODE")};
+        MappedFile file(path, options);
+        CHECK(file.access_trace().empty());
+
+        file.section_data(file.sections()[1]);
+        file.section_data(file.sections()[0]);
+        file.section_data(file.sections()[1]);
+        CHECK(file.access_trace() == std::vector<size_t>{1, 0});
+
+        MappedFile untraced(path);
+        untraced.section_data(untraced.sections()[0]);
+        CHECK(untraced.access_trace().empty());
+    }
+    SECTION("memory usage") {
+        // Only sections spanning at least one huge page are copied onto huge pages
+        std::string large(huge_page_size + 100, 'x');
+        auto large_path = write_temp_file(
+            write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+            + v0::write_sections({
+                {v0::section_name("CODE"), large},
+                {v0::section_name("DATA"), "abc"sv},
+            })
+        );
+        LoadOptions options;
+        options.huge_page_threshold = huge_page_size;
+        MappedFile file(large_path, options);
+        file.section_data(file.sections()[1]);
+
+        auto usage = file.memory_usage();
+        CHECK(usage.mapped_bytes == file.data().size());
+        REQUIRE(usage.sections.size() == 2);
+        REQUIRE(file.is_copied(file.sections()[0]));
+        CHECK(usage.sections[0].copy_bytes == 2 * huge_page_size);
+        CHECK(usage.heap_bytes >= 2 * huge_page_size);
+        CHECK_FALSE(usage.sections[0].shared_copy);
+        CHECK(usage.sections[0].resident_bytes > 0);
+        CHECK(usage.sections[1].copy_bytes == 0);
+        CHECK(usage.sections[1].mapped_bytes > 0);
+        CHECK(usage.sections[1].resident_bytes == usage.sections[1].mapped_bytes);
+        std::remove(large_path.c_str());
+    }
+    SECTION("little-endian file") {
+        auto v1_path = write_temp_file(
+            write_early_header({EarlyHeaderInfo::FileType::library, {1, 0}})
+            + v1::write_sections(v1::little_endian, {{v0::section_name("NUMS"), "\x01\x00\x00\x00"sv}})
+        );
+        MappedFile file(v1_path);
+        CHECK(file.byte_order() == ByteOrder::little);
+        REQUIRE(file.sections().size() == 1);
+        CHECK(file.section_data(file.sections()[0]) == "\x01\x00\x00\x00"sv);
+        std::remove(v1_path.c_str());
+    }
+    SECTION("writable sections") {
+        std::string large(3 * 4096 + 100, 'x');
+        auto cow_path = write_temp_file(
+            write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+            + v0::write_sections({
+                {v0::section_name("SMAL"), "small"sv},
+                {v0::section_name("DATA"), large},
+            })
+        );
+        MappedFile file(cow_path);
+        const auto& small = file.sections()[0];
+        const auto& data = file.sections()[1];
+
+        auto view = file.map_writable(data);
+        CHECK(view->is_copy_on_write());
+        REQUIRE(view->size() == large.size());
+        CHECK(std::string_view(view->data(), view->size()) == large);
+        view->data()[0] = 'y';
+        view->data()[view->size() - 1] = 'z';
+        CHECK(view->data()[0] == 'y');
+        CHECK(file.section_data(data) == large);
+        CHECK(file.map_writable(data)->data()[0] == 'x');
+
+        auto small_view = file.map_writable(small);
+        CHECK_FALSE(small_view->is_copy_on_write());
+        CHECK(std::string_view(small_view->data(), small_view->size()) == "small");
+        small_view->data()[0] = 'S';
+        CHECK(file.section_data(small) == "small");
+
+        LoadOptions options;
+        options.deduplication_threshold = 4096;
+        MappedFile copied(cow_path, options);
+        REQUIRE(copied.is_copied(copied.sections()[1]));
+        auto copied_view = copied.map_writable(copied.sections()[1]);
+        CHECK_FALSE(copied_view->is_copy_on_write());
+        CHECK(std::string_view(copied_view->data(), copied_view->size()) == large);
+        std::remove(cow_path.c_str());
+    }
+    SECTION("empty sections") {
+        std::string large(8192, 'x');
+        for (uint32_t flags : {0u, uint32_t(v1::compact_table), uint32_t(v1::footer_table)}) {
+            INFO("flags: " << flags);
+            auto v1_path = write_temp_file(
+                write_early_header({EarlyHeaderInfo::FileType::library, {1, 0}})
+                + v1::write_sections(flags, {
+                    {v0::section_name("NONE"), ""sv},
+                    {v0::section_name("DATA"), large},
+                    {v0::section_name("LAST"), ""sv},
+                })
+            );
+            MappedFile file(v1_path);
+            REQUIRE(file.sections().size() == 3);
+            for (const auto& section : file.sections()) {
+                CHECK(file.section_data(section).size() == section.size);
+                CHECK_FALSE(file.is_copied(section));
+                CHECK(file.map_writable(section)->size() == section.size);
+
+                // Copies of the table entries are looked up as well
+                auto copy = section;
+                CHECK(file.section_data(copy).size() == section.size);
+            }
+            CHECK(file.section_data(file.sections()[1]) == large);
+            CHECK(file.memory_usage().sections.size() == 3);
+            std::remove(v1_path.c_str());
+        }
+    }
+    SECTION("missing file") {
+        REQUIRE_THROWS_AS(MappedFile(path + ".missing"), LoaderError);
+    }
+
+    std::remove(path.c_str());
+}
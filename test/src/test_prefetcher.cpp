@@ -0,0 +1,68 @@
+#include <catch.hpp>
+
+#include <pex_loader/prefetcher.hpp>
+
+#include "test_utils.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("Prefetcher is working", "[prefetcher]") {
+    using namespace pex::loader;
+
+    std::string big(100000, 'b');
+    auto path = write_temp_file(
+        write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+        + v0::write_sections({
+            {v0::section_name("BIG1"), big},
+            {v0::section_name("BIG2"), big},
+            {v0::section_name("NONE"), ""sv},
+        })
+    );
+    auto file = std::make_shared<const MappedFile>(path);
+    const auto& sections = file->sections();
+
+    SECTION("requests are deduplicated") {
+        // Without threads nothing completes before `wait_idle`, so the queued ranges stay claimed
+        Prefetcher prefetcher(uint64_t(64) << 20, 0);
+        auto queued = prefetcher.request(file, {sections[0]});
+        CHECK(queued >= big.size());
+        CHECK(prefetcher.request(file, {sections[0]}) == 0);
+        CHECK(prefetcher.request(file, {sections[2]}) == 0);
+
+        // Only the pages not shared with the first section are queued
+        auto second = prefetcher.request(file, {sections[0], sections[1]});
+        CHECK(second > 0);
+        CHECK(second <= big.size() + 12);
+
+        prefetcher.wait_idle();
+        CHECK(prefetcher.in_flight_bytes() == 0);
+        CHECK(file->section_data(sections[1]) == big);
+
+        // Warmed pages may be evicted later, so they can be requested again
+        file->release(sections[0]);
+        CHECK(prefetcher.request(file, {sections[0]}) >= big.size());
+        prefetcher.wait_idle();
+    }
+    SECTION("background threads") {
+        Prefetcher prefetcher(uint64_t(64) << 20, 2);
+        CHECK(prefetcher.request(file, {sections[0], sections[1]}) >= 2 * big.size());
+        prefetcher.wait_idle();
+        CHECK(prefetcher.in_flight_bytes() == 0);
+        CHECK(prefetcher.request(file, {sections[0]}) >= big.size());
+        prefetcher.wait_idle();
+    }
+    SECTION("in-flight bytes are capped") {
+        Prefetcher prefetcher(4096);
+        CHECK(prefetcher.request(file, {sections[0], sections[1]}) <= 4096);
+        prefetcher.wait_idle();
+    }
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,110 @@
+#include <catch.hpp>
+
+#include <pex_loader/relocations.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("v0::RelocationTable is working", "[relocations]") {
+    using namespace pex::loader;
+    SECTION("apply") {
+        auto blob = v0::build_relocation_table({
+            {1, v0::RelocationType::add32, 8},
+            {1, v0::RelocationType::add64, 0},
+            {3, v0::RelocationType::add64, 0},
+            {1, v0::RelocationType::add32, 12},
+        });
+        v0::RelocationTable table(blob);
+        CHECK(table.has_relocations(1));
+        CHECK_FALSE(table.has_relocations(2));
+        CHECK(table.has_relocations(3));
+
+        std::string section(
+            "\x00\x00\x00\x00\x00\x00\x01\x00"
+            "\x00\x00\x00\x10"
+            "\xFF\xFF\xFF\xFF"
+            ""sv
+        );
+        table.apply(1, section.data(), section.size(), 0x100000001);
+        CHECK(section == (
+            "\x00\x00\x00\x01\x00\x00\x01\x01"
+            "\x00\x00\x00\x11"
+            "\x00\x00\x00\x00"
+            ""sv
+        ));
+
+        std::string untouched = "abc";
+        table.apply(2, untouched.data(), untouched.size(), 1);
+        CHECK(untouched == "abc");
+    }
+    SECTION("little-endian tables") {
+        auto blob = v0::build_relocation_table(
+            {{1, v0::RelocationType::add32, 0}, {1, v0::RelocationType::add64, 4}},
+            ByteOrder::little
+        );
+        CHECK(blob.substr(0, 8) == "\x02\x00\x00\x00\x01\x00\x00\x00"sv);
+        v0::RelocationTable table(blob, ByteOrder::little);
+        CHECK(table.has_relocations(1));
+        std::string section("\xFF\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00\x00"sv);
+        table.apply(1, section.data(), section.size(), 1);
+        CHECK(section == "\x00\x01\x00\x00\x02\x00\x00\x00\x00\x00\x00\x00"sv);
+
+        auto remapped = v0::remap_relocation_table(blob, {1, 0}, ByteOrder::little);
+        v0::RelocationTable remapped_table(remapped, ByteOrder::little);
+        CHECK(remapped_table.has_relocations(0));
+        CHECK_FALSE(remapped_table.has_relocations(1));
+    }
+    SECTION("many relocations") {
+        std::vector<v0::Relocation> relocations;
+        for (uint64_t i = 0; i < 1000; ++i) {
+            relocations.push_back({0, v0::RelocationType::add32, i * 4});
+        }
+        auto blob = v0::build_relocation_table(relocations);
+        v0::RelocationTable table(blob);
+        std::string section(4000, '\0');
+        table.apply(0, section.data(), section.size(), 7);
+        for (size_t i = 0; i < 1000; ++i) {
+            CHECK(section.substr(i * 4, 4) == "\x00\x00\x00\x07"sv);
+        }
+    }
+    SECTION("out of bounds") {
+        auto blob = v0::build_relocation_table({{0, v0::RelocationType::add64, 1}});
+        v0::RelocationTable table(blob);
+        std::string section(8, '\0');
+        REQUIRE_THROWS_AS(table.apply(0, section.data(), section.size(), 1), LoaderError);
+
+        // Valid relocations in front of the bad one (in another batch and another group) are not
+        // applied either
+        std::vector<v0::Relocation> relocations;
+        for (uint64_t i = 0; i < 1000; ++i) {
+            relocations.push_back({0, v0::RelocationType::add32, i * 4});
+        }
+        relocations.push_back({0, v0::RelocationType::add64, 3999});
+        auto mixed_blob = v0::build_relocation_table(relocations);
+        v0::RelocationTable mixed(mixed_blob);
+        std::string large(4000, '\0');
+        REQUIRE_THROWS_AS(mixed.apply(0, large.data(), large.size(), 1), LoaderError);
+        CHECK(large == std::string(4000, '\0'));
+    }
+    SECTION("invalid type") {
+        auto blob = (
+            "\x00\x00\x00\x01"
+            "\x00\x00\x00\x00" "\x00\x00\x00\x07" "\x00\x00\x00\x00" "\x00\x00\x00\x00" "\x00\x00\x00\x00"
+            ""sv
+        );
+        REQUIRE_THROWS_AS(v0::RelocationTable(blob), LoaderError);
+    }
+    SECTION("truncated directory") {
+        auto blob = (
+            "\x00\x00\x00\x01"
+            "\x00\x00\x00\x00" "\x00\x00\x00\x00"
+            ""sv
+        );
+        REQUIRE_THROWS_AS(v0::RelocationTable(blob), LoaderError);
+    }
+}
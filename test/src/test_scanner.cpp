@@ -0,0 +1,180 @@
+#include <catch.hpp>
+
+#include <pex_loader/format.hpp>
+#include <pex_loader/scanner.hpp>
+
+#include "test_utils.hpp"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+using namespace std::literals;
+
+
+namespace
+{
+
+bool same_sections(const std::vector<pex::loader::v0::Section>& lhs, const std::vector<pex::loader::v0::Section>& rhs)
+{
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        if (lhs[i].offset != rhs[i].offset || lhs[i].size != rhs[i].size || lhs[i].name != rhs[i].name) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+
+TEST_CASE("Sequential scan is working", "[scanner]") {
+    using namespace pex::loader;
+
+    // Sections straddle the boundaries of the 4 KiB reads
+    std::string large(10000, 'L');
+    std::string medium(4090, 'M');
+    std::vector<v0::SectionContents> sections = {
+        {v0::section_name("CODE"), "code"sv},
+        {v0::section_name("DATA"), large},
+        {v0::section_name("NONE"), ""sv},
+        {v0::section_name("DATA"), medium},
+    };
+
+    auto check_scan = [](const std::string& contents) {
+        auto path = write_temp_file(contents);
+        for (bool direct_io : {true, false}) {
+            ScanOptions options;
+            options.read_size = 4096;
+            options.direct_io = direct_io;
+            std::string streamed;
+            options.on_data = [&streamed](uint64_t file_offset, std::string_view data) {
+                CHECK(file_offset == streamed.size());
+                streamed += data;
+            };
+
+            auto result = scan_file(path, options);
+            CHECK(result.file_size == contents.size());
+            CHECK(streamed == contents);
+            CHECK(same_sections(result.sections, read_file_sections(contents)));
+            if (!direct_io) {
+                CHECK_FALSE(result.direct_io);
+            }
+        }
+        std::remove(path.c_str());
+    };
+
+    SECTION("version 0") {
+        check_scan(write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}}) + v0::write_sections(sections));
+        check_scan(write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}}) + v0::write_sections({}));
+    }
+    SECTION("version 1") {
+        auto header = write_early_header({EarlyHeaderInfo::FileType::library, {1, 0}});
+        for (uint32_t flags : {0u, 1u, 2u, 3u, 4u, 5u}) {
+            INFO("flags: " << flags);
+            check_scan(header + v1::write_sections(flags, sections));
+            check_scan(header + v1::write_sections(flags, {}));
+        }
+    }
+    SECTION("malformed files") {
+        auto header = write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}});
+        auto contents = header + v0::write_sections(sections);
+
+        auto scan = [](const std::string& contents) {
+            auto path = write_temp_file(contents);
+            ScanOptions options;
+            options.read_size = 4096;
+            try {
+                scan_file(path, options);
+            } catch (...) {
+                std::remove(path.c_str());
+                throw;
+            }
+            std::remove(path.c_str());
+        };
+
+        REQUIRE_THROWS_AS(scan(contents.substr(0, contents.size() - 1)), LoaderError);
+        REQUIRE_THROWS_AS(scan(contents.substr(0, 12)), LoaderError);
+        REQUIRE_THROWS_AS(scan("PEX"), LoaderError);
+        auto small_size = (
+            "\x00\x00\x00\x00\x00\x00\x00\x01"
+            "\x00\x00\x00\x00\x00\x00\x00\x02"
+            "name"
+            ""s
+        );
+        REQUIRE_THROWS_AS(scan(header + small_size), LoaderError);
+        REQUIRE_THROWS_AS(
+            scan(write_early_header({EarlyHeaderInfo::FileType::library, {7, 0}}) + v0::write_sections({})),
+            LoaderError
+        );
+
+        auto footer = write_early_header({EarlyHeaderInfo::FileType::library, {1, 0}})
+            + v1::write_sections(v1::footer_table, sections);
+        auto unsorted = footer;
+        auto table_offset = unsorted.size() - 20 - sections.size() * 20;
+        unsorted.replace(table_offset, 20, footer, table_offset + 20, 20);
+        unsorted.replace(table_offset + 20, 20, footer, table_offset, 20);
+        REQUIRE_THROWS_AS(scan(unsorted), LoaderError);
+        footer.back() = 'X';
+        REQUIRE_THROWS_AS(scan(footer), LoaderError);
+
+        auto compact = write_early_header({EarlyHeaderInfo::FileType::library, {1, 0}})
+            + v1::write_sections(v1::compact_table, sections);
+        REQUIRE_THROWS_AS(scan(compact.substr(0, compact.size() - 1)), LoaderError);
+    }
+    SECTION("page cache") {
+        auto contents = write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+            + v0::write_sections({{v0::section_name("DATA"), std::string(1 << 20, 'D')}});
+        auto path = write_temp_file(contents);
+        int fd = open(path.c_str(), O_RDONLY);
+        REQUIRE(fd >= 0);
+        REQUIRE(fdatasync(fd) == 0);
+        auto page_size = size_t(sysconf(_SC_PAGESIZE));
+        auto page_count = (contents.size() + page_size - 1) / page_size;
+        auto map = mmap(nullptr, contents.size(), PROT_READ, MAP_SHARED, fd, 0);
+        REQUIRE(map != MAP_FAILED);
+        auto resident_pages = [&]() {
+            std::vector<unsigned char> resident(page_count);
+            REQUIRE(mincore(map, contents.size(), resident.data()) == 0);
+            size_t count = 0;
+            for (auto page : resident) {
+                count += page & 1;
+            }
+            return count;
+        };
+
+        ScanOptions options;
+        options.read_size = 65536;
+        options.direct_io = false;
+
+        // Pages cached before the scan are left alone
+        std::string copy(contents.size(), '\0');
+        REQUIRE(pread(fd, copy.data(), copy.size(), 0) == ssize_t(copy.size()));
+        REQUIRE(resident_pages() == page_count);
+        scan_file(path, options);
+        CHECK(resident_pages() == page_count);
+
+        // The scan drops the pages it reads in itself (if the kernel evicts them on request)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        if (resident_pages() == 0) {
+            scan_file(path, options);
+            CHECK(resident_pages() < page_count / 2);
+        }
+
+        munmap(map, contents.size());
+        close(fd);
+        std::remove(path.c_str());
+    }
+    SECTION("missing file") {
+        REQUIRE_THROWS_AS(scan_file("/nonexistent/file.pex"), LoaderError);
+    }
+}
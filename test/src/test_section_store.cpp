@@ -0,0 +1,113 @@
+#include <catch.hpp>
+
+#include <pex_loader/section_store.hpp>
+
+#include "test_utils.hpp"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("SectionStore is working", "[section_store]") {
+    using namespace pex::loader;
+    SECTION("content hash") {
+        CHECK(content_hash("abc") == content_hash(std::string("abc")));
+        CHECK(content_hash("abc") != content_hash("abd"));
+        CHECK(content_hash("") != content_hash(std::string(1, '\0')));
+
+        std::string long_data(1000, 'x');
+        auto hash = content_hash(long_data);
+        long_data[999] = 'y';
+        CHECK(content_hash(long_data) != hash);
+    }
+    SECTION("content digest") {
+        auto hex = [](const ContentDigest& digest) {
+            std::string out;
+            for (auto byte : digest) {
+                out += "0123456789abcdef"[byte >> 4];
+                out += "0123456789abcdef"[byte & 15];
+            }
+            return out;
+        };
+        CHECK(hex(content_digest("")) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        CHECK(hex(content_digest("abc")) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        CHECK(
+            hex(content_digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"))
+            == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+        );
+        CHECK(
+            hex(content_digest(std::string(1000000, 'a')))
+            == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"
+        );
+    }
+    SECTION("buffers are shared") {
+        SectionStore store;
+        auto a = store.get("shared contents");
+        auto b = store.get(std::string("shared contents"));
+        auto c = store.get("other contents");
+        CHECK(a == b);
+        CHECK(a != c);
+        CHECK(std::string_view(a->data(), a->size()) == "shared contents");
+        CHECK(store.size() == 2);
+
+        a.reset();
+        b.reset();
+        CHECK(store.size() == 1);
+        c.reset();
+        CHECK(store.size() == 0);
+        CHECK(std::string_view(store.get("shared contents")->data(), 15) == "shared contents");
+    }
+    SECTION("concurrent callers") {
+        SectionStore store;
+        std::string contents(100000, 'x');
+        std::vector<std::shared_ptr<const AnonymousBuffer>> results(8);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < results.size(); ++i) {
+            threads.emplace_back([&, i]() {
+                results[i] = store.get(contents);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& result : results) {
+            CHECK(result == results[0]);
+        }
+        CHECK(store.size() == 1);
+    }
+    SECTION("deduplicated sections") {
+        std::string runtime(5000, 'r');
+        auto header = write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}});
+        auto path1 = write_temp_file(header + v0::write_sections({
+            {v0::section_name("RTIM"), runtime},
+            {v0::section_name("CODE"), "first"sv},
+        }));
+        auto path2 = write_temp_file(header + v0::write_sections({
+            {v0::section_name("CODE"), "second"sv},
+            {v0::section_name("RTIM"), runtime},
+        }));
+
+        SectionStore store;
+        LoadOptions options;
+        options.deduplication_threshold = 1000;
+        options.section_store = &store;
+        MappedFile file1(path1, options);
+        MappedFile file2(path2, options);
+
+        auto data1 = file1.section_data(*file1.find_section(v0::section_name("RTIM")));
+        auto data2 = file2.section_data(*file2.find_section(v0::section_name("RTIM")));
+        CHECK(data1 == runtime);
+        CHECK(data1.data() == data2.data());
+        CHECK(file1.section_data(*file1.find_section(v0::section_name("CODE"))) == "first");
+        CHECK(store.size() == 1);
+
+        std::remove(path1.c_str());
+        std::remove(path2.c_str());
+    }
+}
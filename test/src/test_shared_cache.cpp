@@ -0,0 +1,256 @@
+#include <catch.hpp>
+
+#include <pex_loader/format.hpp>
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/shared_cache.hpp>
+
+#include "test_utils.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+using namespace std::literals;
+
+
+namespace
+{
+
+/// Connects to the broker without going through `ModuleCacheClient`
+int connect_raw(const std::string& socket_path)
+{
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    REQUIRE(fd >= 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", socket_path.c_str());
+    REQUIRE(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    return fd;
+}
+
+
+/// Runs `body` in a child process and returns true if it succeeded
+template<typename Body>
+bool run_in_child(Body body)
+{
+    pid_t child = fork();
+    REQUIRE(child >= 0);
+    if (child == 0) {
+        _exit(body() ? 0 : 1);
+    }
+    int status;
+    REQUIRE(waitpid(child, &status, 0) == child);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+}
+
+
+TEST_CASE("Shared module cache is working", "[shared_cache]") {
+    using namespace pex::loader;
+
+    SECTION("sealed buffer") {
+        auto buffer = SealedBuffer::create("test", "sealed contents");
+        CHECK(buffer->data() == "sealed contents");
+        CHECK(write(buffer->fd(), "x", 1) < 0);
+    }
+    SECTION("broker") {
+        auto socket_path = "/tmp/pex_loader_test_broker_" + std::to_string(getpid());
+        ModuleBroker broker(socket_path);
+        ModuleCacheClient client(socket_path);
+
+        CHECK(client.fetch("os") == nullptr);
+
+        int materialized = 0;
+        auto materialize = [&materialized]() {
+            ++materialized;
+            return "decompressed os module"s;
+        };
+        auto first = client.get_or_create("os", materialize);
+        CHECK(first->data() == "decompressed os module");
+        auto second = client.get_or_create("os", materialize);
+        CHECK(second->data() == "decompressed os module");
+        CHECK(materialized == 1);
+        CHECK(broker.size() == 1);
+
+        CHECK_FALSE(client.publish("os", *SealedBuffer::create("other", "other")));
+        CHECK(client.fetch("os")->data() == "decompressed os module");
+
+        // Another process sees the same module
+        CHECK(run_in_child([&socket_path]() {
+            auto module = ModuleCacheClient(socket_path).fetch("os");
+            return module != nullptr && module->data() == "decompressed os module";
+        }));
+
+        // Keys do not end up in the memfd name, which is limited to 249 bytes
+        auto long_key = std::string(300, 'k');
+        CHECK(client.get_or_create(long_key, materialize)->data() == "decompressed os module");
+        CHECK(client.fetch(long_key) != nullptr);
+        REQUIRE_THROWS_AS(client.fetch(std::string(5000, 'k')), LoaderError);
+    }
+    SECTION("misbehaving clients") {
+        auto socket_path = "/tmp/pex_loader_test_broker_" + std::to_string(getpid());
+        BrokerOptions options;
+        options.timeout = 1s;
+        ModuleBroker broker(socket_path, options);
+        ModuleCacheClient client(socket_path);
+        REQUIRE(client.publish("os", *SealedBuffer::create("os", "os module")));
+
+        // A client which never sends its request does not hold up the others
+        int stalled = connect_raw(socket_path);
+        auto start = std::chrono::steady_clock::now();
+        CHECK(client.fetch("os") != nullptr);
+        CHECK(std::chrono::steady_clock::now() - start < 500ms);
+
+        // Malformed requests and unsealed buffers are dropped
+        int garbage = connect_raw(socket_path);
+        REQUIRE(send(garbage, "G\xff\xff\xff\xffos", 7, MSG_NOSIGNAL) == 7);
+        char reply;
+        CHECK(recv(garbage, &reply, 1, 0) <= 0);
+        close(garbage);
+
+        int unsealed = memfd_create("unsealed", MFD_CLOEXEC);
+        REQUIRE(unsealed >= 0);
+        REQUIRE(write(unsealed, "forged", 6) == 6);
+        int forged = connect_raw(socket_path);
+        std::string request = "P\x00\x00\x00\x06forged"s;
+        iovec iov{request.data(), request.size()};
+        msghdr header{};
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+        auto cmsg = CMSG_FIRSTHDR(&header);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &unsealed, sizeof(int));
+        REQUIRE(sendmsg(forged, &header, MSG_NOSIGNAL) == ssize_t(request.size()));
+        CHECK(recv(forged, &reply, 1, 0) <= 0);
+        close(forged);
+        close(unsealed);
+        CHECK(client.fetch("forged") == nullptr);
+
+        // The stalled connection is closed once it times out
+        CHECK(recv(stalled, &reply, 1, 0) == 0);
+        close(stalled);
+        CHECK(client.fetch("os")->data() == "os module");
+        CHECK(broker.size() == 1);
+    }
+    SECTION("publishing users") {
+        if (geteuid() != 0) {
+            // Needs to switch to another user
+            return;
+        }
+        auto socket_path = "/tmp/pex_loader_test_broker_" + std::to_string(getpid());
+        auto publish_as_nobody = [&socket_path]() {
+            return run_in_child([&socket_path]() {
+                if (setuid(65534) != 0) {
+                    return false;
+                }
+                return ModuleCacheClient(socket_path).publish("os", *SealedBuffer::create("os", "nobody"));
+            });
+        };
+        {
+            ModuleBroker broker(socket_path);
+            REQUIRE(chmod(socket_path.c_str(), 0777) == 0);
+            CHECK_FALSE(publish_as_nobody());
+            CHECK(ModuleCacheClient(socket_path).fetch("os") == nullptr);
+        }
+        {
+            BrokerOptions options;
+            options.allowed_uids = {65534};
+            ModuleBroker broker(socket_path, options);
+            REQUIRE(chmod(socket_path.c_str(), 0777) == 0);
+            CHECK(publish_as_nobody());
+            CHECK(ModuleCacheClient(socket_path).fetch("os")->data() == "nobody");
+        }
+    }
+    SECTION("eviction") {
+        auto socket_path = "/tmp/pex_loader_test_broker_" + std::to_string(getpid());
+        BrokerOptions options;
+        options.max_bytes = 10;
+        ModuleBroker broker(socket_path, options);
+        ModuleCacheClient client(socket_path);
+
+        auto first = SealedBuffer::create("a", "aaaa");
+        REQUIRE(client.publish("a", *first));
+        REQUIRE(client.publish("b", *SealedBuffer::create("b", "bbbb")));
+        // Touching "a" makes "b" the least recently used module
+        CHECK(client.fetch("a") != nullptr);
+        REQUIRE(client.publish("c", *SealedBuffer::create("c", "cccc")));
+        CHECK(broker.size() == 2);
+        CHECK(broker.bytes() == 8);
+        CHECK(client.fetch("b") == nullptr);
+        CHECK(client.fetch("c") != nullptr);
+
+        CHECK_FALSE(client.publish("d", *SealedBuffer::create("d", "more than ten bytes")));
+        // Evicted modules stay valid for their users
+        REQUIRE(client.publish("e", *SealedBuffer::create("e", "eeeeeeeeee")));
+        CHECK(client.fetch("a") == nullptr);
+        CHECK(first->data() == "aaaa");
+    }
+    SECTION("mapped file") {
+        auto socket_path = "/tmp/pex_loader_test_broker_" + std::to_string(getpid());
+        std::string large(huge_page_size + 100, 'L');
+        std::string medium(10000, 'M');
+        auto blob = write_early_header({EarlyHeaderInfo::FileType::library, {0, 0}})
+            + v0::write_sections({
+                {v0::section_name("HEAD"), "head"sv},
+                {v0::section_name("CODE"), large},
+                {v0::section_name("DATA"), medium},
+            });
+        auto path = write_temp_file(blob);
+        ModuleBroker broker(socket_path);
+        ModuleCacheClient client(socket_path);
+        LoadOptions options;
+        options.module_cache = &client;
+
+        // Without section copies nothing is published: the file is mapped directly
+        MappedFile plain(path, options);
+        CHECK(broker.size() == 0);
+        CHECK(plain.mapping().data() == blob);
+
+        // The huge page copy and the deduplicated copy are published once and mapped by every load
+        options.huge_page_threshold = 1;
+        options.deduplication_threshold = 4096;
+        MappedFile first(path, options);
+        MappedFile second(path, options);
+        CHECK(broker.size() == 2);
+        CHECK(broker.bytes() == large.size() + medium.size());
+        CHECK(first.mapping().path() == path);
+        for (const auto* file : {&first, &second}) {
+            CHECK(file->section_data(file->sections()[1]) == large);
+            CHECK(file->section_data(file->sections()[2]) == medium);
+            CHECK(reinterpret_cast<uintptr_t>(file->section_data(file->sections()[1]).data()) % huge_page_size == 0);
+            auto usage = file->memory_usage();
+            CHECK(usage.sections[1].shared_copy);
+            CHECK(usage.sections[2].shared_copy);
+            CHECK_FALSE(file->is_copied(file->sections()[0]));
+        }
+        CHECK(first.map_writable(first.sections()[2])->data()[0] == 'M');
+
+        // Without a broker the copies are private
+        ModuleCacheClient missing("/tmp/pex_loader_test_no_such_broker");
+        options.module_cache = &missing;
+        MappedFile direct(path, options);
+        CHECK(direct.section_data(direct.sections()[1]) == large);
+        CHECK_FALSE(direct.memory_usage().sections[1].shared_copy);
+        std::remove(path.c_str());
+    }
+    SECTION("missing broker") {
+        ModuleCacheClient client("/tmp/pex_loader_test_no_such_broker");
+        REQUIRE_THROWS_AS(client.fetch("os"), LoaderError);
+    }
+}
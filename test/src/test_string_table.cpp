@@ -0,0 +1,118 @@
+#include <catch.hpp>
+
+#include <pex_loader/string_table.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("v0::StringTable is working", "[string_table]") {
+    using namespace pex::loader;
+    SECTION("views point into the section") {
+        auto blob = v0::build_string_table({"hello"sv, ""sv, "world"sv});
+        v0::StringTable table(blob);
+        REQUIRE(table.size() == 3);
+        CHECK(table[0] == "hello");
+        CHECK(table[1] == "");
+        CHECK(table[2] == "world");
+        CHECK(table[2].data() >= blob.data());
+        CHECK(table[2].data() < blob.data() + blob.size());
+        CHECK(table.hash(0) == name_hash("hello"));
+        REQUIRE_THROWS_AS(table[3], LoaderError);
+
+        auto little = v0::build_string_table({"hello"sv, "world"sv}, ByteOrder::little);
+        CHECK(little.substr(0, 4) == "\x02\x00\x00\x00"sv);
+        v0::StringTable little_table(little, ByteOrder::little);
+        CHECK(little_table[1] == "world");
+        CHECK(little_table.hash(1) == name_hash("world"));
+    }
+    SECTION("interning") {
+        auto blob1 = v0::build_string_table({"print"sv, "len"sv});
+        auto blob2 = v0::build_string_table({"len"sv, "print"sv, "input"sv});
+        v0::StringTable table1(blob1);
+        v0::StringTable table2(blob2);
+
+        StringInterner interner;
+        auto print = table1.intern(0, interner);
+        auto len = table1.intern(1, interner);
+        CHECK(print == "print");
+        CHECK(print.data() != table1[0].data());
+        CHECK(table2.intern(0, interner).data() == len.data());
+        CHECK(table2.intern(1, interner).data() == print.data());
+        CHECK(table2.intern(2, interner) == "input");
+        CHECK(interner.size() == 3);
+        REQUIRE(interner.find("len", name_hash("len")));
+        CHECK(interner.find("len", name_hash("len"))->data() == len.data());
+        CHECK(interner.find("print")->data() == print.data());
+        CHECK(!interner.find("open", name_hash("open")));
+        CHECK(!interner.find("len", name_hash("len") + 1));
+    }
+    SECTION("wrong stored hash") {
+        // Both entries claim the hash of "len"
+        auto blob = v0::build_string_table({"len"sv, "print"sv});
+        blob.replace(4 + 12 + 8, 4, blob, 4 + 8, 4);
+        v0::StringTable table(blob);
+
+        StringInterner interner;
+        auto len = table.intern(0, interner);
+        REQUIRE_THROWS_AS(table.intern(1, interner), LoaderError);
+        REQUIRE_THROWS_AS(interner.intern("len", name_hash("print")), LoaderError);
+        CHECK(interner.intern("len").data() == len.data());
+        CHECK(interner.size() == 1);
+    }
+    SECTION("interner growth") {
+        std::vector<std::string> strings;
+        for (int i = 0; i < 5000; ++i) {
+            strings.push_back("s" + std::to_string(i));
+        }
+        StringInterner interner;
+        std::vector<std::string_view> interned;
+        for (const auto& str : strings) {
+            interned.push_back(interner.intern(str));
+            CHECK(interned.back() == str);
+        }
+        for (size_t i = 0; i < strings.size(); ++i) {
+            CHECK(interner.intern(std::string(strings[i])).data() == interned[i].data());
+        }
+        CHECK(interner.size() == 5000);
+    }
+    SECTION("interned strings outlive their source") {
+        StringInterner interner;
+        std::string_view name;
+        std::string_view long_name;
+        {
+            auto blob = v0::build_string_table({"open"sv, std::string(100000, 'x')});
+            v0::StringTable table(blob);
+            name = table.intern(0, interner);
+            long_name = table.intern(1, interner);
+            blob.assign(blob.size(), '\0');
+        }
+        CHECK(name == "open");
+        CHECK(long_name == std::string(100000, 'x'));
+        CHECK(interner.intern("open").data() == name.data());
+        CHECK(interner.find(std::string(100000, 'x'))->data() == long_name.data());
+        CHECK(interner.intern("").empty());
+    }
+    SECTION("truncated table") {
+        auto blob = (
+            "\x00\x00\x00\x02"
+            "\x00\x00\x00\x00" "\x00\x00\x00\x01" "\x00\x00\x00\x00"
+            ""sv
+        );
+        REQUIRE_THROWS_AS(v0::StringTable(blob), LoaderError);
+    }
+    SECTION("string out of bounds") {
+        auto blob = (
+            "\x00\x00\x00\x01"
+            "\x00\x00\x00\x00" "\x00\x00\x00\x04" "\x00\x00\x00\x00"
+            "abc"
+            ""sv
+        );
+        v0::StringTable table(blob);
+        REQUIRE_THROWS_AS(table[0], LoaderError);
+    }
+}
@@ -0,0 +1,72 @@
+#include <catch.hpp>
+
+#include <pex_loader/symbol_table.hpp>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("v0::SymbolTable is working", "[symbol_table]") {
+    using namespace pex::loader;
+    SECTION("empty table") {
+        auto blob = v0::build_symbol_table({});
+        v0::SymbolTable table(blob);
+        CHECK(table.size() == 0);
+        CHECK_FALSE(table.lookup("main"));
+    }
+    SECTION("lookup") {
+        std::vector<std::pair<std::string, uint64_t>> symbols;
+        for (uint64_t i = 0; i < 1000; ++i) {
+            symbols.emplace_back("symbol_" + std::to_string(i), i * 3);
+        }
+        auto blob = v0::build_symbol_table(symbols);
+        v0::SymbolTable table(blob);
+        REQUIRE(table.size() == 1000);
+
+        for (const auto& [name, value] : symbols) {
+            auto symbol = table.lookup(name);
+            REQUIRE(symbol);
+            CHECK(symbol->name == name);
+            CHECK(symbol->value == value);
+            CHECK(table.may_contain(name_hash(name)));
+        }
+        CHECK_FALSE(table.lookup("symbol_1000"));
+        CHECK_FALSE(table.lookup(""));
+        CHECK_FALSE(table.lookup("symbol_"));
+    }
+    SECTION("little-endian table") {
+        auto blob = v0::build_symbol_table({{"main", 0x1122}, {"exit", 7}}, ByteOrder::little);
+        CHECK(blob.substr(0, 4) == "\x02\x00\x00\x00"sv);
+        v0::SymbolTable table(blob, ByteOrder::little);
+        REQUIRE(table.size() == 2);
+        auto symbol = table.lookup("main");
+        REQUIRE(symbol);
+        CHECK(symbol->value == 0x1122);
+        CHECK(table.lookup("exit")->value == 7);
+        CHECK_FALSE(table.lookup("other"));
+    }
+    SECTION("hash") {
+        CHECK(name_hash("") == 5381);
+        CHECK(name_hash("a") == 5381 * 33 + 'a');
+    }
+    SECTION("truncated table") {
+        auto blob = v0::build_symbol_table({{"a", 1}, {"b", 2}});
+        REQUIRE_THROWS_AS(v0::SymbolTable(std::string_view(blob).substr(0, 15)), LoaderError);
+        REQUIRE_THROWS_AS(v0::SymbolTable(std::string_view(blob).substr(0, 40)), LoaderError);
+    }
+    SECTION("invalid bloom filter size") {
+        auto blob = (
+            "\x00\x00\x00\x00"
+            "\x00\x00\x00\x01"
+            "\x00\x00\x00\x03"
+            "\x00\x00\x00\x06"
+            ""sv
+        );
+        REQUIRE_THROWS_AS(v0::SymbolTable(blob), LoaderError);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <catch.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+
+/// Writes the contents into a new temporary file and returns its path
+inline std::string write_temp_file(std::string_view contents)
+{
+    char path[] = "/tmp/pex_loader_test_XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd >= 0);
+    REQUIRE(write(fd, contents.data(), contents.size()) == ssize_t(contents.size()));
+    close(fd);
+    return path;
+}
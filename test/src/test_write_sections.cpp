@@ -0,0 +1,97 @@
+#include <catch.hpp>
+
+#include <pex_loader/pex_loader.hpp>
+#include <pex_loader/relocations.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+using namespace std::literals;
+
+
+TEST_CASE("v0::write_sections is working", "[write_sections]") {
+    using namespace pex::loader;
+    SECTION("early header") {
+        EarlyHeaderInfo info{EarlyHeaderInfo::FileType::library, {0, 3}};
+        auto blob = write_early_header(info);
+        CHECK(blob == "PEX\x02\x00\x00\x00\x03"sv);
+        auto parsed = read_early_header(blob);
+        CHECK(parsed.file_type == EarlyHeaderInfo::FileType::library);
+        CHECK(parsed.format_version.major == 0);
+        CHECK(parsed.format_version.minor == 3);
+    }
+    SECTION("round trip") {
+        auto blob = v0::write_sections({
+            {v0::section_name("1234"), "Hello"sv},
+            {v0::section_name("test"), ""sv},
+        });
+        CHECK(blob == (
+            "\x00\x00\x00\x00\x00\x00\x00\x02"
+            "\x00\x00\x00\x00\x00\x00\x00\x09"
+            "1234"
+            "Hello"
+            "\x00\x00\x00\x00\x00\x00\x00\x04"
+            "test"
+            ""sv
+        ));
+
+        auto sections = v0::read_sections(blob);
+        REQUIRE(sections.size() == 2);
+        CHECK(sections[0].offset == 20);
+        CHECK(sections[0].size == 5);
+        CHECK(sections[1].name == v0::section_name("test"));
+    }
+    SECTION("reorder") {
+        auto blob = v0::write_sections({
+            {v0::section_name("AAAA"), "a"sv},
+            {v0::section_name("BBBB"), "bb"sv},
+            {v0::section_name("CCCC"), "ccc"sv},
+            {v0::section_name("DDDD"), "dddd"sv},
+        });
+        auto reordered = v0::reorder_sections(blob, {2, 0, 2});
+        auto sections = v0::read_sections(reordered);
+        REQUIRE(sections.size() == 4);
+        CHECK(sections[0].name == v0::section_name("CCCC"));
+        CHECK(sections[1].name == v0::section_name("AAAA"));
+        CHECK(sections[2].name == v0::section_name("BBBB"));
+        CHECK(sections[3].name == v0::section_name("DDDD"));
+        CHECK(reordered.substr(sections[3].offset, sections[3].size) == "dddd");
+        CHECK(reordered.size() == blob.size());
+
+        REQUIRE_THROWS_AS(v0::reorder_sections(blob, {4}), LoaderError);
+    }
+    SECTION("reorder relocated module") {
+        auto relocations = v0::build_relocation_table({
+            {0, v0::RelocationType::add32, 0},
+            {2, v0::RelocationType::add64, 0},
+            {2, v0::RelocationType::add32, 8},
+        });
+        auto blob = v0::write_sections({
+            {v0::section_name("CODE"), "\x00\x00\x00\x01"sv},
+            {v0::relocation_section_name, relocations},
+            {v0::section_name("DATA"), "\x00\x00\x00\x00\x00\x00\x00\x02\x00\x00\x00\x03"sv},
+        });
+        auto reordered = v0::reorder_sections(blob, {2});
+        auto sections = v0::read_sections(reordered);
+        REQUIRE(sections.size() == 3);
+        REQUIRE(sections[0].name == v0::section_name("DATA"));
+        REQUIRE(sections[2].name == v0::relocation_section_name);
+
+        v0::RelocationTable table(std::string_view(reordered).substr(sections[2].offset, sections[2].size));
+        CHECK_FALSE(table.has_relocations(2));
+        auto data = reordered.substr(sections[0].offset, sections[0].size);
+        table.apply(0, data.data(), data.size(), 0x10);
+        CHECK(data == "\x00\x00\x00\x00\x00\x00\x00\x12\x00\x00\x00\x13"sv);
+        auto code = reordered.substr(sections[1].offset, sections[1].size);
+        table.apply(1, code.data(), code.size(), 0x10);
+        CHECK(code == "\x00\x00\x00\x11"sv);
+
+        auto dangling = v0::write_sections({
+            {v0::section_name("CODE"), "\x00\x00\x00\x01"sv},
+            {v0::relocation_section_name, v0::build_relocation_table({{5, v0::RelocationType::add32, 0}})},
+        });
+        REQUIRE_THROWS_AS(v0::reorder_sections(dangling, {1}), LoaderError);
+    }
+}
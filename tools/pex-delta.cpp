@@ -0,0 +1,47 @@
+// Creates and applies section-level deltas between PEX files.
+//
+//     pex-delta make <old.pex> <new.pex> <delta>
+//     pex-delta apply <old.pex> <delta> <new.pex>
+
+#include <pex_loader/delta.hpp>
+#include <pex_loader/mapped_file.hpp>
+
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+
+int main(int argc, char** argv)
+{
+    using namespace pex::loader;
+
+    if (argc != 5 || (std::string(argv[1]) != "make" && std::string(argv[1]) != "apply")) {
+        std::cerr << "Usage: " << argv[0] << " make <old.pex> <new.pex> <delta>\n"
+                  << "       " << argv[0] << " apply <old.pex> <delta> <new.pex>\n";
+        return EXIT_FAILURE;
+    }
+
+    try {
+        if (std::string(argv[1]) == "make") {
+            FileMapping old_file(argv[2]);
+            FileMapping new_file(argv[3]);
+            auto delta = make_delta(old_file.data(), new_file.data());
+
+            std::ofstream output(argv[4], std::ios::binary | std::ios::trunc);
+            output.write(delta.data(), std::streamsize(delta.size()));
+            output.close();
+            if (!output) {
+                throw LoaderError(std::string("Unable to write '") + argv[4] + "'");
+            }
+        } else {
+            FileMapping delta(argv[3]);
+            apply_delta(argv[2], delta.data(), argv[4]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
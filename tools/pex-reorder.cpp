@@ -0,0 +1,59 @@
+// Rewrites a PEX file so that the sections listed in an access trace come first.
+//
+// The trace is a text file with whitespace-separated section indices, as returned by
+// `MappedFile::access_trace` of a file loaded with `LoadOptions::trace_access`.
+
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+
+int main(int argc, char** argv)
+{
+    using namespace pex::loader;
+
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <input.pex> <trace.txt> <output.pex>\n";
+        return EXIT_FAILURE;
+    }
+
+    try {
+        FileMapping input(argv[1]);
+        auto header = read_early_header(input.data());
+        if (header.format_version.major != 0) {
+            throw LoaderError("Only format major version 0 can be reordered");
+        }
+
+        std::ifstream trace_file(argv[2]);
+        if (!trace_file) {
+            throw LoaderError(std::string("Unable to open trace file '") + argv[2] + "'");
+        }
+        std::vector<size_t> hot_sections;
+        size_t index;
+        while (trace_file >> index) {
+            hot_sections.push_back(index);
+        }
+        if (!trace_file.eof()) {
+            throw LoaderError(std::string("Invalid trace file '") + argv[2] + "'");
+        }
+
+        auto output_data = write_early_header(header)
+            + v0::reorder_sections(input.data().substr(early_header_size), hot_sections);
+
+        std::ofstream output(argv[3], std::ios::binary | std::ios::trunc);
+        output.write(output_data.data(), std::streamsize(output_data.size()));
+        output.close();
+        if (!output) {
+            throw LoaderError(std::string("Unable to write '") + argv[3] + "'");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
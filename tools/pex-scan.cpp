@@ -0,0 +1,31 @@
+// Validates PEX files by reading them sequentially, without evicting the page cache of other
+// processes (see `scan_file`). Prints one line per invalid file.
+
+#include <pex_loader/scanner.hpp>
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+
+int main(int argc, char** argv)
+{
+    using namespace pex::loader;
+
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <file.pex>...\n";
+        return EXIT_FAILURE;
+    }
+
+    int status = EXIT_SUCCESS;
+    for (int i = 1; i < argc; ++i) {
+        try {
+            scan_file(argv[i]);
+        } catch (const std::exception& e) {
+            std::cout << argv[i] << ": " << e.what() << '\n';
+            status = EXIT_FAILURE;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,75 @@
+// Moves debug sections of a PEX file into a companion file referenced by a debug link.
+//
+// The companion path stored in the debug link is the file name of <output.debug>, so both files
+// are expected to be installed into the same directory.
+
+#include <pex_loader/debug_info.hpp>
+#include <pex_loader/mapped_file.hpp>
+#include <pex_loader/pex_loader.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+void write_file(const std::string& path, const std::string& data)
+{
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output.write(data.data(), std::streamsize(data.size()));
+    output.close();
+    if (!output) {
+        throw pex::loader::LoaderError("Unable to write '" + path + "'");
+    }
+}
+
+}
+
+
+int main(int argc, char** argv)
+{
+    using namespace pex::loader;
+
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " <input.pex> <output.pex> <output.debug> <section>...\n";
+        return EXIT_FAILURE;
+    }
+
+    try {
+        FileMapping input(argv[1]);
+        auto header = read_early_header(input.data());
+        if (header.format_version.major != 0) {
+            throw LoaderError("Only format major version 0 can be split");
+        }
+
+        std::vector<std::array<char, 4>> debug_section_names;
+        for (int i = 4; i < argc; ++i) {
+            if (std::strlen(argv[i]) != 4) {
+                throw LoaderError(std::string("Section names must be 4 characters long: '") + argv[i] + "'");
+            }
+            debug_section_names.push_back({argv[i][0], argv[i][1], argv[i][2], argv[i][3]});
+        }
+
+        std::string debug_path = argv[3];
+        auto split = v0::split_debug_sections(
+            input.data().substr(early_header_size),
+            debug_section_names,
+            debug_path.substr(debug_path.rfind('/') + 1)
+        );
+
+        auto debug_header = header;
+        debug_header.file_type = EarlyHeaderInfo::FileType::other;
+        write_file(debug_path, write_early_header(debug_header) + split.debug_sections);
+        write_file(argv[2], write_early_header(header) + split.main_sections);
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}